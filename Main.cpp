@@ -1,17 +1,468 @@
 /////////////////////////////////////////////////////////////////////////////////////////////////
-///      THIS FILE CONTAINS THE MAIN FUNCTION, WHICH IS DESIGNATED START OF THE PROGRAM       /// 
+///      THIS FILE CONTAINS THE MAIN FUNCTION, WHICH IS DESIGNATED START OF THE PROGRAM       ///
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "examples/BVHExample.h"
+#include <cstring>
+#include <filesystem>
 
 using namespace std;
 
+/**
+* Compares the throughput of the memory-mapped loader (parallel and single-threaded) with the original stream based loader.
+* The parallel load uses the threads given by --threads (one per hardware thread by default) and its vertices are checked to be identical to those
+* of the single-threaded load; the parse is also timed with the powers of two threads up to those, which shows its scaling.
+* The *.stl, *.ply, and *.obj files are loaded by their importers and the importer throughput is reported instead.
+* Usage: --bench-load [file...] (the default model is used if no file is given).
+*/
+int benchmarkLoad(int argc, char** argv)
+{
+	vector<string> paths;
+	for (int i = 2; i < argc; i++)
+	{
+		paths.push_back(argv[i]);
+	}
+	if (paths.empty())
+	{
+		paths.push_back("models/car.raw");
+	}
+
+	for (const string& path : paths)
+	{
+		MeshData mesh;
+		if (filesystem::path(path).extension() != ".raw")
+		{
+			LoadStats imported;
+			if (!ModelLoader::loadSource(path, mesh, imported))
+			{
+				cout << "WARNING: the file " << path << " could not be loaded." << endl;
+				continue;
+			}
+			cout << path << " (" << mesh.triangleCount() << " triangles, " << imported.bytes / (1024.0 * 1024.0) << " MB)" << endl;
+			cout << "  " << imported.format << " importer: " << imported.throughput() << " MB/s, " << imported.totalSeconds * 1000 << " ms in total" << endl;
+			continue;
+		}
+
+		MeshData serialMesh;
+		LoadStats stream, mapped;
+		if (!ModelLoader::loadRawStream(path, mesh, stream) || !ModelLoader::loadRaw(path, mesh, mapped, TaskPool::defaultThreads))
+		{
+			cout << "WARNING: the file " << path << " could not be opened." << endl;
+			continue;
+		}
+		cout << path << " (" << mesh.triangleCount() << " triangles, " << mapped.bytes / (1024.0 * 1024.0) << " MB)" << endl;
+		cout << "  ifstream >> float: " << stream.throughput() << " MB/s, " << stream.totalSeconds * 1000 << " ms in total" << endl;
+		cout << "  mapped from_chars: " << mapped.throughput() << " MB/s, " << mapped.totalSeconds * 1000 << " ms in total (" << mapped.threads << " threads)" << endl;
+
+		LoadStats serial;
+		ModelLoader::loadRaw(path, serialMesh, serial, 1);
+		cout << "  mapped, 1 thread:  " << serial.throughput() << " MB/s, " << serial.totalSeconds * 1000 << " ms in total" << endl;
+
+		// the scaling of the parse with the number of threads up to those of the parallel load (the file gives each thread at least one chunk)
+		for (unsigned threads = 2; threads <= mapped.threads; threads *= 2)
+		{
+			MeshData scaledMesh;
+			LoadStats scaled;
+			ModelLoader::loadRaw(path, scaledMesh, scaled, threads);
+			cout << "  mapped, " << scaled.threads << " threads: " << scaled.throughput() << " MB/s, " << scaled.parseSeconds * 1000 << " ms parsing, "
+				<< serial.parseSeconds / scaled.parseSeconds << "x the single thread" << endl;
+		}
+
+		// the chunks start at line boundaries, so the parallel parse must give the same bytes as the sequential one
+		if (mesh.vertices.size() != serialMesh.vertices.size() || memcmp(mesh.vertices.data(), serialMesh.vertices.data(), mesh.vertices.size() * sizeof(float)) != 0)
+		{
+			cout << "WARNING: the vertices parsed by " << mapped.threads << " threads differ from the sequential parse." << endl;
+		}
+
+		LoadStats binary;
+		if (ModelLoader::loadBinary(ModelLoader::binaryPath(path), mesh, binary))
+		{
+			cout << "  bmesh:             " << binary.throughput() << " MB/s, " << binary.totalSeconds * 1000 << " ms in total" << endl;
+		}
+	}
+	return 0;
+}
+
+/**
+* Imports the fixture files listed in the manifest and compares their triangle counts and bounding boxes with the expected values,
+* so the STL, PLY, and OBJ importers are checked on files exercising the fan triangulation, the negative OBJ indices, the PLY property types, and the STL size check.
+* Each line of the manifest holds a file relative to the manifest, its number of triangles, and its bounding box in the file coordinates,
+* or the file followed by "fail" if it must be rejected; the lines starting with '#' are comments.
+* Usage: --check-import [manifest] (models/fixtures/expected.txt by default).
+*/
+int checkImport(int argc, char** argv)
+{
+	const string manifest = argc > 2 ? argv[2] : "models/fixtures/expected.txt";
+	ifstream in(manifest);
+	if (!in)
+	{
+		cout << "WARNING: the file " << manifest << " could not be opened." << endl;
+		return 1;
+	}
+
+	int failed = 0;
+	string line;
+	while (getline(in, line))
+	{
+		istringstream words(line);
+		string name, expected;
+		if (!(words >> name >> expected) || name[0] == '#')
+		{
+			continue;
+		}
+		const string path = (filesystem::path(manifest).parent_path() / name).string();
+		MeshData mesh;
+		LoadStats stats;
+		const bool loaded = ModelLoader::loadSource(path, mesh, stats);
+		if (expected == "fail")
+		{
+			cout << (loaded ? "FAILED: " : "ok: ") << path << (loaded ? " was loaded, but it should be rejected" : " was rejected") << endl;
+			failed += loaded ? 1 : 0;
+			continue;
+		}
+
+		const size_t triangles = stoul(expected);
+		float bounds[6] = {};
+		for (float& bound : bounds)
+		{
+			words >> bound;
+		}
+		const Tuple3f min(bounds[0], bounds[1], bounds[2]);
+		const Tuple3f max(bounds[3], bounds[4], bounds[5]);
+		const auto near = [](const Tuple3f& a, const Tuple3f& b)
+		{
+			return std::abs(a.x - b.x) <= 1e-5f && std::abs(a.y - b.y) <= 1e-5f && std::abs(a.z - b.z) <= 1e-5f;
+		};
+		if (!loaded || mesh.triangleCount() != triangles || !near(mesh.boundingMin, min) || !near(mesh.boundingMax, max))
+		{
+			cout << "FAILED: " << path << (loaded ? "" : " could not be loaded") << ": " << mesh.triangleCount() << " triangles in " << mesh.boundingMin << " - " << mesh.boundingMax
+				<< ", expected " << triangles << " in " << min << " - " << max << endl;
+			failed++;
+			continue;
+		}
+		cout << "ok: " << path << " (" << stats.format << "), " << triangles << " triangles" << endl;
+	}
+	return failed == 0 ? 0 : 1;
+}
+
+/**
+* Converts all *.raw, *.stl, *.ply, and *.obj files in the given directory into the binary *.bmesh files next to them.
+* Usage: --convert [directory] (the default directory is 'models').
+*/
+int convertModels(int argc, char** argv)
+{
+	const string directory = argc > 2 ? argv[2] : "models";
+
+	error_code error;
+	int failed = 0;
+	for (const auto& entry : filesystem::directory_iterator(directory, error))
+	{
+		const string extension = entry.path().extension().string();
+		if (!entry.is_regular_file() || (extension != ".raw" && extension != ".stl" && extension != ".ply" && extension != ".obj"))
+		{
+			continue;
+		}
+
+		const string path = entry.path().string();
+		const string converted = ModelLoader::binaryPath(path);
+		MeshData mesh;
+		LoadStats stats;
+		if (!ModelLoader::loadSource(path, mesh, stats) || !ModelLoader::saveBinary(converted, mesh))
+		{
+			cout << "WARNING: " << path << " could not be converted." << endl;
+			failed++;
+			continue;
+		}
+		cout << path << " -> " << converted << " (" << mesh.triangleCount() << " triangles)" << endl;
+	}
+	if (error)
+	{
+		cout << "WARNING: the directory " << directory << " could not be read." << endl;
+		return 1;
+	}
+	return failed == 0 ? 0 : 1;
+}
+
+/**
+* Builds the tree for the default model and writes it into a memory-mappable BVH image.
+* Usage: --export-image file [aabb|sphere]
+*/
+int exportImage(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		cout << "Usage: --export-image file [aabb|sphere]" << endl;
+		return 1;
+	}
+
+	BVHExample window = BVHExample();
+	if (argc > 3 && string(argv[3]) == "sphere")
+	{
+		window.setVolumeType(VolumeType::Sphere);
+	}
+	if (!window.exportImage(argv[2]))
+	{
+		cout << "WARNING: the image " << argv[2] << " could not be written." << endl;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+* Answers the potentially visible set query directly from a mapped BVH image.
+* Usage: --query-image file x y z nx ny nz (the camera position and the normal of the camera plane).
+*/
+int queryImage(int argc, char** argv)
+{
+	if (argc < 9)
+	{
+		cout << "Usage: --query-image file x y z nx ny nz" << endl;
+		return 1;
+	}
+
+	const auto start = chrono::steady_clock::now();
+	BVHImage image(argv[2]);
+	if (!image.isValid())
+	{
+		cout << "WARNING: " << argv[2] << " is not a valid BVH image." << endl;
+		return 1;
+	}
+	const double mapped = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	const Tuple3f cameraPosition(stof(argv[3]), stof(argv[4]), stof(argv[5]));
+	Vector3f cameraNormal(stof(argv[6]), stof(argv[7]), stof(argv[8]));
+	cameraNormal.Normalize();
+
+	vector<uint32_t> visible;
+	int testedTriangles = 0;
+	image.pvs(cameraPosition, cameraNormal, visible, testedTriangles);
+	const double total = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	cout << argv[2] << ": " << image.getNodeCount() << " nodes, " << image.getTriangleCount() << " triangles, mapped in " << mapped << " ms" << endl;
+	cout << "PVS: " << visible.size() << ", Actually Tested: " << testedTriangles << ", " << total - mapped << " ms" << endl;
+	return 0;
+}
+
+/**
+* Builds the trees of the given models and appends the memory of each tree as a line of JSON to the file (see BVHFootprint).
+* Fails if a tree could not be built or if its arena used more than it was sized for.
+* Usage: --footprint file [aabb|sphere] [depth] [model...] (the default model and depth are used if none are given).
+*/
+int writeFootprint(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		cout << "Usage: --footprint file [aabb|sphere] [depth] [model...]" << endl;
+		return 1;
+	}
+
+	ofstream out(argv[2], ios::app);
+	if (!out)
+	{
+		cout << "WARNING: the file " << argv[2] << " could not be opened." << endl;
+		return 1;
+	}
+
+	BVHExample window = BVHExample();
+	if (argc > 3 && string(argv[3]) == "sphere")
+	{
+		window.setVolumeType(VolumeType::Sphere);
+	}
+	if (argc > 4)
+	{
+		window.setDepth(stoi(argv[4]));
+	}
+	vector<string> paths;
+	for (int i = 5; i < argc; i++)
+	{
+		paths.push_back(argv[i]);
+	}
+
+	int failed = 0;
+	if (paths.empty())
+	{
+		failed += window.writeFootprint(out) ? 0 : 1;
+	}
+	for (const string& path : paths)
+	{
+		window.setModel(path);
+		failed += window.writeFootprint(out) ? 0 : 1;
+	}
+	return failed == 0 ? 0 : 1;
+}
+
+/**
+* Compares the trees cut at the midpoints with the trees cut by the binned SAH, the SBVH, and the linear trees of the Morton codes by the average work of the pvs() queries.
+* The midpoint and SAH trees are built both with the crossing triangles in both children and with the triangles partitioned by their centroids.
+* Usage: --bench-split [aabb|sphere] [depth] [model...] (the default model and depth are used if none are given).
+*/
+int benchmarkSplit(int argc, char** argv)
+{
+	BVHExample window = BVHExample();
+	if (argc > 2 && string(argv[2]) == "sphere")
+	{
+		window.setVolumeType(VolumeType::Sphere);
+	}
+	if (argc > 3)
+	{
+		window.setDepth(stoi(argv[3]));
+	}
+	vector<string> paths;
+	for (int i = 4; i < argc; i++)
+	{
+		paths.push_back(argv[i]);
+	}
+
+	const int directions = 200;
+	for (size_t model = 0; model < std::max<size_t>(paths.size(), 1); model++)
+	{
+		if (!paths.empty())
+		{
+			window.setModel(paths[model]);
+		}
+		cout << (paths.empty() ? string("The default model") : paths[model]) << " (average of " << directions << " queries)" << endl;
+		const tuple<SplitMethod, int, string> methods[] = {
+			{ SplitMethod::Midpoint, 16, "midpoint:    " },
+			{ SplitMethod::BinnedSAH, 8, "SAH 8 bins:  " },
+			{ SplitMethod::BinnedSAH, 16, "SAH 16 bins: " },
+			{ SplitMethod::BinnedSAH, 32, "SAH 32 bins: " },
+			{ SplitMethod::Spatial, 16, "SBVH 16 bins:" },
+			{ SplitMethod::Morton, 16, "Morton:      " }
+		};
+		for (const auto& method : methods)
+		{
+			// the SBVH and the Morton codes choose the partitions themselves
+			for (bool partition : { false, true })
+			{
+				if (partition && (get<0>(method) == SplitMethod::Spatial || get<0>(method) == SplitMethod::Morton))
+				{
+					continue;
+				}
+				window.setPartitionByCentroids(partition);
+				window.setSplitMethod(get<0>(method), get<1>(method));
+				const BVHQueryStats stats = window.measureQueries(directions);
+				cout << "  " << get<2>(method) << " " << (partition ? "(centroids) " : "") << stats.visitedNodes << " nodes visited, " << stats.testedTriangles << " triangles tested, "
+					<< stats.visibleTriangles << " visible, " << stats.milliseconds << " ms" << endl;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+* Refits the trees of the given models to a wave deforming them and compares the refits with the rebuilds by their time and by the average work of the pvs() queries.
+* Usage: --bench-refit [aabb|sphere] [depth] [model...] (the default model and depth are used if none are given).
+*/
+int benchmarkRefit(int argc, char** argv)
+{
+	BVHExample window = BVHExample();
+	if (argc > 2 && string(argv[2]) == "sphere")
+	{
+		window.setVolumeType(VolumeType::Sphere);
+	}
+	if (argc > 3)
+	{
+		window.setDepth(stoi(argv[3]));
+	}
+	vector<string> paths;
+	for (int i = 4; i < argc; i++)
+	{
+		paths.push_back(argv[i]);
+	}
+
+	const int frames = 20;
+	const int directions = 200;
+	for (size_t model = 0; model < std::max<size_t>(paths.size(), 1); model++)
+	{
+		if (!paths.empty())
+		{
+			window.setModel(paths[model]);
+		}
+		const BVHRefitStats stats = window.measureRefit(frames, 0.05f, directions);
+		cout << (paths.empty() ? string("The default model") : paths[model]) << " (" << frames << " frames, average of " << directions << " queries)" << endl;
+		cout << "  refit:   " << stats.refitMilliseconds << " ms, " << stats.refitted.visitedNodes << " nodes visited, " << stats.refitted.testedTriangles << " triangles tested" << endl;
+		cout << "  rebuild: " << stats.rebuildMilliseconds << " ms, " << stats.rebuilt.visitedNodes << " nodes visited, " << stats.rebuilt.testedTriangles << " triangles tested" << endl;
+	}
+	return 0;
+}
+
 int main(int argc, char **argv) {
-	
+
+	// --huge-pages may be given with any other option; the memory arenas then request huge pages from the system
+	for (int i = 1; i < argc; i++)
+	{
+		if (string(argv[i]) == "--huge-pages")
+		{
+			MemoryArena::useHugePages = true;
+			copy(argv + i + 1, argv + argc, argv + i);
+			argv[--argc] = nullptr;
+			break;
+		}
+	}
+
+	// --threads N may be given with any other option; the trees are then built by N threads (1 - serially)
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (string(argv[i]) == "--threads")
+		{
+			TaskPool::defaultThreads = static_cast<unsigned>(std::max(1, stoi(argv[i + 1])));
+			copy(argv + i + 2, argv + argc, argv + i);
+			argc -= 2;
+			argv[argc] = nullptr;
+			break;
+		}
+	}
+
+	// --scene-budget N may be given with any other option; the scene then holds models of at most N MB before it evicts the least recently used ones
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (string(argv[i]) == "--scene-budget")
+		{
+			SceneManager::defaultBudget = static_cast<size_t>(std::max(0, stoi(argv[i + 1]))) * 1024 * 1024;
+			copy(argv + i + 2, argv + argc, argv + i);
+			argc -= 2;
+			argv[argc] = nullptr;
+			break;
+		}
+	}
+
+	if (argc > 1 && string(argv[1]) == "--bench-load")
+	{
+		return benchmarkLoad(argc, argv);
+	}
+	if (argc > 1 && string(argv[1]) == "--check-import")
+	{
+		return checkImport(argc, argv);
+	}
+	if (argc > 1 && string(argv[1]) == "--convert")
+	{
+		return convertModels(argc, argv);
+	}
+	if (argc > 1 && string(argv[1]) == "--export-image")
+	{
+		return exportImage(argc, argv);
+	}
+	if (argc > 1 && string(argv[1]) == "--query-image")
+	{
+		return queryImage(argc, argv);
+	}
+	if (argc > 1 && string(argv[1]) == "--bench-split")
+	{
+		return benchmarkSplit(argc, argv);
+	}
+	if (argc > 1 && string(argv[1]) == "--bench-refit")
+	{
+		return benchmarkRefit(argc, argv);
+	}
+	if (argc > 1 && string(argv[1]) == "--footprint")
+	{
+		return writeFootprint(argc, argv);
+	}
+
 	BVHExample window = BVHExample();
 
 	window.show(argc, argv);
 
 	glutMainLoop();
 	return 0;
-}
\ No newline at end of file
+}
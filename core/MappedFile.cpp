@@ -0,0 +1,101 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const string& path)
+{
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		return;
+	}
+	if (fileSize.QuadPart == 0)
+	{
+		empty = true;
+		return;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		return;
+	}
+	mappingHandle = mapping;
+
+	bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (bytes != nullptr)
+	{
+		length = static_cast<size_t>(fileSize.QuadPart);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (bytes != nullptr)
+	{
+		UnmapViewOfFile(bytes);
+	}
+	if (mappingHandle != nullptr)
+	{
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != nullptr)
+	{
+		CloseHandle(fileHandle);
+	}
+}
+
+#else
+
+MappedFile::MappedFile(const string& path)
+{
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return;
+	}
+
+	struct stat info;
+	const bool found = fstat(file, &info) == 0;
+	empty = found && info.st_size == 0;
+	if (found && info.st_size > 0)
+	{
+		void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapped != MAP_FAILED)
+		{
+			madvise(mapped, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+			bytes = static_cast<const char*>(mapped);
+			length = static_cast<size_t>(info.st_size);
+		}
+	}
+	// the mapping stays valid after the descriptor is closed
+	close(file);
+}
+
+MappedFile::~MappedFile()
+{
+	if (bytes != nullptr)
+	{
+		munmap(const_cast<char*>(bytes), length);
+	}
+}
+
+#endif
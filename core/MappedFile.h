@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+/**
+* The read-only memory mapping of a whole file.
+* The mapping is released when the object is destroyed, so the pointer returned by data() must not outlive it.
+*/
+class MappedFile
+{
+
+private:
+
+	/** The pointer to the first byte of the mapped file (nullptr if the file could not be mapped). */
+	const char* bytes = nullptr;
+	/** The size of the mapped file in bytes. */
+	size_t length = 0;
+	/** True if the file was opened but is empty, so there is nothing to map. */
+	bool empty = false;
+#ifdef _WIN32
+	/** The handle of the opened file. */
+	void* fileHandle = nullptr;
+	/** The handle of the file mapping object. */
+	void* mappingHandle = nullptr;
+#endif
+
+public:
+
+	/** Maps the file on the given path into the memory. */
+	MappedFile(const string& path);
+
+	/** Unmaps the file. */
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/** Returns true if the file was successfully mapped. Note that empty files are never mapped (see isEmpty()). */
+	bool isOpen() const
+	{
+		return bytes != nullptr;
+	}
+
+	/** Returns true if the file exists but is empty, as opposed to a file that could not be opened or mapped. */
+	bool isEmpty() const
+	{
+		return empty;
+	}
+
+	/** Returns the pointer to the first byte of the file. */
+	const char* data() const
+	{
+		return bytes;
+	}
+
+	/** Returns the size of the file in bytes. */
+	size_t size() const
+	{
+		return length;
+	}
+};
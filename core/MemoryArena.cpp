@@ -0,0 +1,134 @@
+#include "MemoryArena.h"
+#include <algorithm>
+#include <cstdint>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/** The size of the huge pages on Linux (the transparent huge pages of x86-64). */
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+/** The size of the regular pages. */
+static const size_t PAGE_SIZE = 4096;
+
+/** Rounds the size up to a multiple of the given power of two. */
+static inline size_t roundUp(const size_t size, const size_t multiple)
+{
+	return (size + multiple - 1) & ~(multiple - 1);
+}
+
+MemoryArena::~MemoryArena()
+{
+	for (const Chunk& chunk : chunks)
+	{
+		releaseChunk(chunk);
+	}
+}
+
+void* MemoryArena::allocate(const size_t size, const size_t alignment)
+{
+	// the allocation fits into the current chunk or into one of the chunks kept by reset()
+	for (; current < chunks.size(); current++)
+	{
+		const uintptr_t base = reinterpret_cast<uintptr_t>(chunks[current].memory);
+		const size_t start = roundUp(base + offset, alignment) - base;
+		if (start + size <= chunks[current].size)
+		{
+			offset = start + size;
+			return chunks[current].memory + start;
+		}
+		usedBefore += offset;
+		offset = 0;
+	}
+
+	const Chunk chunk = allocateChunk(std::max(chunkSize, size + alignment), hugePages);
+	if (chunk.memory == nullptr)
+	{
+		throw bad_alloc();
+	}
+	chunkSize *= 2;
+	chunks.push_back(chunk);
+
+	const uintptr_t base = reinterpret_cast<uintptr_t>(chunk.memory);
+	const size_t start = roundUp(base, alignment) - base;
+	offset = start + size;
+	return chunk.memory + start;
+}
+
+size_t MemoryArena::reservedBytes() const
+{
+	size_t bytes = 0;
+	for (const Chunk& chunk : chunks)
+	{
+		bytes += chunk.size;
+	}
+	return bytes;
+}
+
+bool MemoryArena::hasHugePages() const
+{
+	for (const Chunk& chunk : chunks)
+	{
+		if (chunk.hugePages)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+#ifdef _WIN32
+
+MemoryArena::Chunk MemoryArena::allocateChunk(const size_t size, const bool hugePages)
+{
+	// the large pages need the "Lock pages in memory" privilege; without it the regular pages are used
+	const size_t largePage = GetLargePageMinimum();
+	if (hugePages && largePage != 0)
+	{
+		const size_t rounded = roundUp(size, largePage);
+		void* memory = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (memory != nullptr)
+		{
+			return Chunk{ static_cast<char*>(memory), rounded, true };
+		}
+	}
+
+	const size_t rounded = roundUp(size, PAGE_SIZE);
+	void* memory = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	return Chunk{ static_cast<char*>(memory), memory != nullptr ? rounded : 0, false };
+}
+
+void MemoryArena::releaseChunk(const Chunk& chunk)
+{
+	VirtualFree(chunk.memory, 0, MEM_RELEASE);
+}
+
+#else
+
+MemoryArena::Chunk MemoryArena::allocateChunk(const size_t size, const bool hugePages)
+{
+	const size_t rounded = roundUp(size, hugePages ? HUGE_PAGE_SIZE : PAGE_SIZE);
+	void* memory = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+	{
+		return Chunk{ nullptr, 0, false };
+	}
+
+	// the transparent huge pages are only a hint; the chunk is still usable if the kernel does not support them
+	bool huge = false;
+#ifdef MADV_HUGEPAGE
+	huge = hugePages && madvise(memory, rounded, MADV_HUGEPAGE) == 0;
+#endif
+	return Chunk{ static_cast<char*>(memory), rounded, huge };
+}
+
+void MemoryArena::releaseChunk(const Chunk& chunk)
+{
+	munmap(chunk.memory, chunk.size);
+}
+
+#endif
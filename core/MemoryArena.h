@@ -0,0 +1,211 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+/**
+* The bump allocator owning a few large chunks of memory obtained directly from the operating system.
+*
+* The allocations only advance the position in the current chunk, and the individual allocations are never freed;
+* the whole arena is either reset, which keeps the chunks for the next use, or destroyed, which returns them to the system.
+* Both take constant time regardless of the number of allocations.
+* The chunks may be backed by huge pages (large pages on Windows), which reduces the TLB misses when large trees are traversed.
+*/
+class MemoryArena
+{
+
+public:
+
+	/** The size of the chunks used if none is given. */
+	static const size_t DEFAULT_CHUNK_SIZE = 1024 * 1024;
+
+	/** If true the new arenas request huge pages from the system (set by the --huge-pages option). */
+	inline static bool useHugePages = false;
+
+private:
+
+	/** A chunk of memory obtained from the system. */
+	struct Chunk
+	{
+		/** The first byte of the chunk. */
+		char* memory;
+		/** The size of the chunk in bytes. */
+		size_t size;
+		/** True if the chunk is backed by huge pages. */
+		bool hugePages;
+	};
+
+	/** The chunks in the order in which they are filled. */
+	vector<Chunk> chunks;
+	/** The index of the chunk the allocations are served from. */
+	size_t current = 0;
+	/** The number of bytes used in the current chunk. */
+	size_t offset = 0;
+	/** The number of bytes used in the chunks before the current one. */
+	size_t usedBefore = 0;
+	/** The size of the next chunk; it doubles with every new chunk, so the number of chunks stays small. */
+	size_t chunkSize;
+	/** True if the chunks should be backed by huge pages. */
+	bool hugePages;
+
+public:
+
+	/**
+	* Constructs an empty arena; no memory is obtained until the first allocation.
+	*
+	* @param chunkSize	The size of the first chunk in bytes; it should fit everything that is going to be allocated.
+	* @param hugePages	If true the chunks are backed by huge pages whenever the system provides them.
+	*/
+	MemoryArena(size_t chunkSize = DEFAULT_CHUNK_SIZE, bool hugePages = useHugePages) : chunkSize(chunkSize), hugePages(hugePages)
+	{
+	}
+
+	/** Returns all chunks to the system. */
+	~MemoryArena();
+
+	MemoryArena(const MemoryArena&) = delete;
+	MemoryArena& operator=(const MemoryArena&) = delete;
+
+	/**
+	* Allocates the given number of bytes; the memory stays valid until the arena is reset or destroyed.
+	*
+	* @param size		The number of bytes.
+	* @param alignment	The alignment of the memory (a power of two).
+	*/
+	void* allocate(size_t size, size_t alignment = alignof(max_align_t));
+
+	/** Discards all allocations but keeps the chunks, so the arena can be filled again without asking the system for memory. */
+	void reset()
+	{
+		current = 0;
+		offset = 0;
+		usedBefore = 0;
+	}
+
+	/** Returns the number of bytes allocated since the last reset (including the alignment padding). */
+	size_t usedBytes() const
+	{
+		return usedBefore + offset;
+	}
+
+	/** Returns the number of bytes obtained from the system. */
+	size_t reservedBytes() const;
+
+	/** Returns true if at least one chunk is backed by huge pages. */
+	bool hasHugePages() const;
+
+private:
+
+	/** Obtains a chunk of at least the given size from the system; returns a chunk without memory on failure. */
+	static Chunk allocateChunk(size_t size, bool hugePages);
+
+	/** Returns the chunk to the system. */
+	static void releaseChunk(const Chunk& chunk);
+};
+
+/**
+* The allocator of the standard containers that takes the memory from a MemoryArena; the deallocation does nothing, since the arena frees everything at once.
+* Without an arena the memory is taken from the heap. The memory is always aligned to at least the given number of bytes.
+*/
+template <typename T, size_t ALIGNMENT = alignof(T)>
+class ArenaAllocator
+{
+
+public:
+
+	typedef T value_type;
+	// containers assigned from each other take over the arena with the memory
+	typedef true_type propagate_on_container_copy_assignment;
+	typedef true_type propagate_on_container_move_assignment;
+	typedef true_type propagate_on_container_swap;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef ArenaAllocator<U, ALIGNMENT> other;
+	};
+
+	/** The arena the memory is taken from (nullptr for the heap). */
+	MemoryArena* arena;
+
+	/** Constructs the allocator taking the memory from the given arena. */
+	ArenaAllocator(MemoryArena* arena = nullptr) : arena(arena)
+	{
+	}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U, ALIGNMENT>& other) : arena(other.arena)
+	{
+	}
+
+	T* allocate(size_t count)
+	{
+		const size_t alignment = ALIGNMENT > alignof(T) ? ALIGNMENT : alignof(T);
+		if (arena != nullptr)
+		{
+			return static_cast<T*>(arena->allocate(count * sizeof(T), alignment));
+		}
+		return static_cast<T*>(::operator new(count * sizeof(T), align_val_t(alignment)));
+	}
+
+	void deallocate(T* pointer, size_t)
+	{
+		if (arena == nullptr)
+		{
+			::operator delete(pointer, align_val_t(ALIGNMENT > alignof(T) ? ALIGNMENT : alignof(T)));
+		}
+	}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U, ALIGNMENT>& other) const
+	{
+		return arena == other.arena;
+	}
+
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U, ALIGNMENT>& other) const
+	{
+		return arena != other.arena;
+	}
+};
+
+/** The vector taking its memory from a MemoryArena. */
+template <typename T, size_t ALIGNMENT = alignof(T)>
+using ArenaVector = vector<T, ArenaAllocator<T, ALIGNMENT>>;
+
+/**
+* Makes room for the given number of elements; the capacity at least doubles, as if the vector grew by itself.
+* The arena cannot reuse the array a vector leaves behind when it grows, so a vector that already has an array in the arena
+* moves to the heap instead, where it keeps growing without stranding its old arrays until the arena is reset.
+*/
+template <typename T, size_t ALIGNMENT>
+void reserveGrowth(ArenaVector<T, ALIGNMENT>& array, size_t count)
+{
+	if (count <= array.capacity())
+	{
+		return;
+	}
+	const size_t capacity = std::max(count, array.capacity() * 2);
+	if (array.get_allocator().arena == nullptr || array.capacity() == 0)
+	{
+		array.reserve(capacity);
+		return;
+	}
+	ArenaVector<T, ALIGNMENT> grown;
+	grown.reserve(capacity);
+	grown.assign(make_move_iterator(array.begin()), make_move_iterator(array.end()));
+	// the allocator is moved with the array, so the vector takes its memory from the heap from now on
+	array = std::move(grown);
+}
+
+/** Returns the number of bytes of the array if it is on the heap (e.g., moved there by reserveGrowth()), zero if it is in an arena. */
+template <typename T, size_t ALIGNMENT>
+size_t heapCapacityBytes(const ArenaVector<T, ALIGNMENT>& array)
+{
+	return array.get_allocator().arena == nullptr ? array.capacity() * sizeof(T) : 0;
+}
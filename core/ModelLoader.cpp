@@ -0,0 +1,920 @@
+#include "ModelLoader.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+/** Returns the number of seconds elapsed since the given time point. */
+static double secondsSince(const chrono::steady_clock::time_point& start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/** Updates the bounding box with the given coordinate of the given axis (0 - x, 1 - y, 2 - z). */
+static inline void extend(Tuple3f& boundingMin, Tuple3f& boundingMax, const int axis, const float value)
+{
+	switch (axis)
+	{
+	case 0:
+		boundingMin.x = std::min(boundingMin.x, value);
+		boundingMax.x = std::max(boundingMax.x, value);
+		break;
+	case 1:
+		boundingMin.y = std::min(boundingMin.y, value);
+		boundingMax.y = std::max(boundingMax.y, value);
+		break;
+	default:
+		boundingMin.z = std::min(boundingMin.z, value);
+		boundingMax.z = std::max(boundingMax.z, value);
+		break;
+	}
+}
+
+Tuple3f ModelLoader::emptyMin()
+{
+	return Tuple3f(numeric_limits<float>::max(), numeric_limits<float>::max(), numeric_limits<float>::max());
+}
+
+Tuple3f ModelLoader::emptyMax()
+{
+	return Tuple3f(numeric_limits<float>::lowest(), numeric_limits<float>::lowest(), numeric_limits<float>::lowest());
+}
+
+size_t ModelLoader::parseFloats(const char* first, const char* last, vector<float>& out, Tuple3f& boundingMin, Tuple3f& boundingMax)
+{
+	size_t rejected = 0;
+	size_t lineStart = out.size();
+	bool valid = true;
+	const char* p = first;
+	while (true)
+	{
+		if (p == last || *p == '\n')
+		{
+			// the vertices of a line are kept only if all its tokens are floats and they form whole triangles (nine floats each, an empty line has none),
+			// so a bad line never shifts the vertices of the next triangles
+			const size_t count = out.size() - lineStart;
+			if (valid && count % 9 == 0)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					extend(boundingMin, boundingMax, static_cast<int>(i % 3), out[lineStart + i]);
+				}
+			}
+			else
+			{
+				out.resize(lineStart);
+				rejected++;
+			}
+			if (p == last)
+			{
+				break;
+			}
+			p++;
+			lineStart = out.size();
+			valid = true;
+			continue;
+		}
+		// whitespace (spaces, tabs and the carriage returns)
+		if (*p <= ' ')
+		{
+			p++;
+			continue;
+		}
+		// std::from_chars does not accept the leading plus sign
+		if (*p == '+')
+		{
+			p++;
+		}
+
+		float value;
+		const from_chars_result result = from_chars(p, last, value);
+		if (result.ec != errc() || (result.ptr != last && *result.ptr > ' '))
+		{
+			// the rest of the token is skipped and the line is dropped at its end
+			valid = false;
+			while (p != last && *p > ' ')
+			{
+				p++;
+			}
+			continue;
+		}
+		p = result.ptr;
+		out.push_back(value);
+	}
+	return rejected;
+}
+
+void ModelLoader::normalize(MeshData& mesh)
+{
+	float dist = std::max({ mesh.boundingMax.x - mesh.boundingMin.x, mesh.boundingMax.y - mesh.boundingMin.y, mesh.boundingMax.z - mesh.boundingMin.z });
+
+	mesh.scale = dist > 0 ? 2.f / dist : 1.f;
+	mesh.center = (mesh.boundingMin + mesh.boundingMax) / 2;
+
+	const float scale = mesh.scale;
+	const float cx = mesh.center.x;
+	const float cy = mesh.center.y;
+	const float cz = mesh.center.z;
+	float* v = mesh.vertices.data();
+	const size_t count = mesh.vertices.size() - mesh.vertices.size() % 3;
+	for (size_t i = 0; i < count; i += 3)
+	{
+		v[i] = (v[i] - cx) * scale;
+		v[i + 1] = (v[i + 1] - cy) * scale;
+		v[i + 2] = (v[i + 2] - cz) * scale;
+	}
+}
+
+/** The minimum number of bytes parsed by a single thread; smaller files are not worth splitting. */
+static const size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+/** The part of the *.raw file parsed by a single thread. */
+struct RawChunk
+{
+	/** The first character of the chunk (always at the start of a line). */
+	const char* first = nullptr;
+	/** The character after the last character of the chunk (always after the end of a line). */
+	const char* last = nullptr;
+	/** The parsed floats. */
+	vector<float> vertices;
+	/** The minimum corner of the parsed vertices. */
+	Tuple3f boundingMin;
+	/** The maximum corner of the parsed vertices. */
+	Tuple3f boundingMax;
+	/** The number of lines that could not be parsed. */
+	size_t rejected = 0;
+};
+
+/** Parses the given chunk, reserving its vertex array from its line count first. */
+static void parseChunk(RawChunk& chunk)
+{
+	chunk.vertices.reserve((std::count(chunk.first, chunk.last, '\n') + 1) * 9);
+	chunk.boundingMin = ModelLoader::emptyMin();
+	chunk.boundingMax = ModelLoader::emptyMax();
+	chunk.rejected = ModelLoader::parseFloats(chunk.first, chunk.last, chunk.vertices, chunk.boundingMin, chunk.boundingMax);
+}
+
+bool ModelLoader::loadRaw(const string& path, MeshData& mesh, LoadStats& stats, unsigned threads)
+{
+	const auto start = chrono::steady_clock::now();
+
+	MappedFile file(path);
+	// an empty file is a valid model without triangles, as it was for the stream loader
+	if (!file.isOpen() && !file.isEmpty())
+	{
+		return false;
+	}
+
+	const char* first = file.data();
+	const char* last = first + file.size();
+
+	if (threads == 0)
+	{
+		threads = std::max(1u, thread::hardware_concurrency());
+	}
+	threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(1, file.size() / MIN_CHUNK_SIZE)));
+
+	// splits the file into chunks of similar size that end at line boundaries; each line is one triangle, so the chunks are independent
+	vector<RawChunk> chunks(threads);
+	const char* chunkStart = first;
+	for (unsigned i = 0; i < threads; i++)
+	{
+		const char* chunkEnd = i + 1 == threads ? last : std::max(chunkStart, first + file.size() * (i + 1) / threads);
+		chunkEnd = std::find(chunkEnd, last, '\n');
+		if (chunkEnd != last)
+		{
+			chunkEnd++;
+		}
+		chunks[i].first = chunkStart;
+		chunks[i].last = chunkEnd;
+		chunkStart = chunkEnd;
+	}
+
+	vector<thread> workers;
+	for (size_t i = 1; i < chunks.size(); i++)
+	{
+		workers.emplace_back(parseChunk, ref(chunks[i]));
+	}
+	parseChunk(chunks[0]);
+	for (thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	// stitches the chunks together in the file order
+	size_t size = 0;
+	size_t rejected = 0;
+	mesh.boundingMin = emptyMin();
+	mesh.boundingMax = emptyMax();
+	for (const RawChunk& chunk : chunks)
+	{
+		size += chunk.vertices.size();
+		rejected += chunk.rejected;
+		mesh.boundingMin = Tuple3f(std::min(mesh.boundingMin.x, chunk.boundingMin.x), std::min(mesh.boundingMin.y, chunk.boundingMin.y), std::min(mesh.boundingMin.z, chunk.boundingMin.z));
+		mesh.boundingMax = Tuple3f(std::max(mesh.boundingMax.x, chunk.boundingMax.x), std::max(mesh.boundingMax.y, chunk.boundingMax.y), std::max(mesh.boundingMax.z, chunk.boundingMax.z));
+	}
+
+	if (chunks.size() == 1)
+	{
+		mesh.vertices = move(chunks[0].vertices);
+	}
+	else
+	{
+		mesh.vertices.resize(size);
+		float* out = mesh.vertices.data();
+		for (const RawChunk& chunk : chunks)
+		{
+			memcpy(out, chunk.vertices.data(), chunk.vertices.size() * sizeof(float));
+			out += chunk.vertices.size();
+		}
+	}
+
+	if (rejected > 0)
+	{
+		cout << "WARNING: " << rejected << " lines of " << path << " are not whole triangles of floats and were skipped." << endl;
+	}
+
+	stats.format = "raw";
+	stats.bytes = file.size();
+	stats.threads = threads;
+	stats.parseSeconds = secondsSince(start);
+
+	normalize(mesh);
+
+	stats.totalSeconds = secondsSince(start);
+	return true;
+}
+
+bool ModelLoader::loadRawStream(const string& path, MeshData& mesh, LoadStats& stats)
+{
+	const auto start = chrono::steady_clock::now();
+
+	ifstream file(path, ios::binary | ios::ate);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	stats.format = "raw (stream)";
+	stats.bytes = static_cast<size_t>(file.tellg());
+	file.seekg(0);
+
+	mesh.vertices.clear();
+	float vertex;
+	while (file >> vertex) {
+		mesh.vertices.push_back(vertex);
+	}
+
+	stats.parseSeconds = secondsSince(start);
+
+	mesh.boundingMin = emptyMin();
+	mesh.boundingMax = emptyMax();
+	for (size_t i = 0; i + 2 < mesh.vertices.size(); i += 3) {
+		extend(mesh.boundingMin, mesh.boundingMax, 0, mesh.vertices[i]);
+		extend(mesh.boundingMin, mesh.boundingMax, 1, mesh.vertices[i + 1]);
+		extend(mesh.boundingMin, mesh.boundingMax, 2, mesh.vertices[i + 2]);
+	}
+	normalize(mesh);
+
+	stats.totalSeconds = secondsSince(start);
+	return true;
+}
+
+string ModelLoader::binaryPath(const string& path)
+{
+	return filesystem::path(path).replace_extension(MESH_FILE_EXTENSION).string();
+}
+
+bool ModelLoader::load(const string& path, MeshData& mesh, LoadStats& stats)
+{
+	// prefer the converted file unless the original was modified after the conversion
+	const string converted = binaryPath(path);
+	if (converted != path)
+	{
+		error_code error;
+		const auto convertedTime = filesystem::last_write_time(converted, error);
+		if (!error && convertedTime >= filesystem::last_write_time(path, error) && !error && loadBinary(converted, mesh, stats))
+		{
+			return true;
+		}
+	}
+
+	return loadSource(path, mesh, stats);
+}
+
+bool ModelLoader::loadSource(const string& path, MeshData& mesh, LoadStats& stats)
+{
+	char magic[sizeof(MESH_FILE_MAGIC)] = {};
+	ifstream file(path, ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	file.read(magic, sizeof(magic));
+	file.close();
+
+	if (memcmp(magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC)) == 0)
+	{
+		return loadBinary(path, mesh, stats);
+	}
+	if (memcmp(magic, "ply", 3) == 0 && (magic[3] == '\n' || magic[3] == '\r'))
+	{
+		return loadPly(path, mesh, stats);
+	}
+
+	string extension = filesystem::path(path).extension().string();
+	transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+	if (extension == ".stl")
+	{
+		return loadStl(path, mesh, stats);
+	}
+	if (extension == ".obj")
+	{
+		return loadObj(path, mesh, stats);
+	}
+	return loadRaw(path, mesh, stats);
+}
+
+bool ModelLoader::loadBinary(const string& path, MeshData& mesh, LoadStats& stats)
+{
+	const auto start = chrono::steady_clock::now();
+
+	MappedFile file(path);
+	if (!file.isOpen() || file.size() < sizeof(MeshFileHeader))
+	{
+		return false;
+	}
+
+	MeshFileHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC)) != 0)
+	{
+		return false;
+	}
+	if (header.version != MESH_FILE_VERSION)
+	{
+		cout << "WARNING: " << path << " has unsupported version " << header.version << "." << endl;
+		return false;
+	}
+	const size_t payload = static_cast<size_t>(header.triangleCount) * 9 * sizeof(float);
+	if (file.size() - sizeof(header) < payload)
+	{
+		cout << "WARNING: " << path << " is truncated." << endl;
+		return false;
+	}
+
+	mesh.vertices.resize(static_cast<size_t>(header.triangleCount) * 9);
+	memcpy(mesh.vertices.data(), file.data() + sizeof(header), payload);
+	mesh.boundingMin = Tuple3f(header.boundingMin[0], header.boundingMin[1], header.boundingMin[2]);
+	mesh.boundingMax = Tuple3f(header.boundingMax[0], header.boundingMax[1], header.boundingMax[2]);
+	mesh.center = Tuple3f(header.center[0], header.center[1], header.center[2]);
+	mesh.scale = header.scale;
+
+	stats.format = "bmesh";
+	stats.bytes = sizeof(header) + payload;
+	stats.parseSeconds = secondsSince(start);
+	stats.totalSeconds = stats.parseSeconds;
+	return true;
+}
+
+bool ModelLoader::saveBinary(const string& path, const MeshData& mesh)
+{
+	ofstream file(path, ios::binary | ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	MeshFileHeader header = {};
+	memcpy(header.magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC));
+	header.version = MESH_FILE_VERSION;
+	header.triangleCount = static_cast<uint32_t>(mesh.triangleCount());
+	header.boundingMin[0] = mesh.boundingMin.x;
+	header.boundingMin[1] = mesh.boundingMin.y;
+	header.boundingMin[2] = mesh.boundingMin.z;
+	header.boundingMax[0] = mesh.boundingMax.x;
+	header.boundingMax[1] = mesh.boundingMax.y;
+	header.boundingMax[2] = mesh.boundingMax.z;
+	header.center[0] = mesh.center.x;
+	header.center[1] = mesh.center.y;
+	header.center[2] = mesh.center.z;
+	header.scale = mesh.scale;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(mesh.vertices.data()), static_cast<streamsize>(header.triangleCount) * 9 * sizeof(float));
+	return file.good();
+}
+
+/** Appends the triangle with the given vertices of the position array (three floats per vertex) and updates the bounding box. */
+static inline void appendTriangle(vector<float>& out, const float* positions, const uint32_t a, const uint32_t b, const uint32_t c, Tuple3f& boundingMin, Tuple3f& boundingMax)
+{
+	for (const uint32_t vertex : { a, b, c })
+	{
+		const float* position = positions + static_cast<size_t>(vertex) * 3;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			out.push_back(position[axis]);
+			extend(boundingMin, boundingMax, axis, position[axis]);
+		}
+	}
+}
+
+/** The size of the binary STL header preceding the triangle count. */
+static const size_t STL_HEADER_SIZE = 80;
+/** The size of a single binary STL triangle record (the normal, three vertices, and the attribute byte count). */
+static const size_t STL_RECORD_SIZE = 50;
+/** The offset of the first vertex in the binary STL triangle record. */
+static const size_t STL_VERTEX_OFFSET = 12;
+
+bool ModelLoader::loadStl(const string& path, MeshData& mesh, LoadStats& stats)
+{
+	const auto start = chrono::steady_clock::now();
+
+	MappedFile file(path);
+	if (!file.isOpen() || file.size() < STL_HEADER_SIZE + sizeof(uint32_t))
+	{
+		return false;
+	}
+
+	uint32_t count;
+	memcpy(&count, file.data() + STL_HEADER_SIZE, sizeof(count));
+	// some exporters start the binary header with "solid" too, so only the size tells an ASCII file from a binary one
+	if ((file.size() - STL_HEADER_SIZE - sizeof(uint32_t)) / STL_RECORD_SIZE < count)
+	{
+		cout << "WARNING: " << path << " is truncated or is an ASCII STL file; only binary STL files are supported." << endl;
+		return false;
+	}
+
+	mesh.vertices.resize(static_cast<size_t>(count) * 9);
+	mesh.boundingMin = emptyMin();
+	mesh.boundingMax = emptyMax();
+	const char* record = file.data() + STL_HEADER_SIZE + sizeof(uint32_t);
+	float* out = mesh.vertices.data();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		memcpy(out, record + STL_VERTEX_OFFSET, 9 * sizeof(float));
+		for (int j = 0; j < 9; j++)
+		{
+			extend(mesh.boundingMin, mesh.boundingMax, j % 3, out[j]);
+		}
+		out += 9;
+		record += STL_RECORD_SIZE;
+	}
+
+	stats.format = "stl";
+	stats.bytes = STL_HEADER_SIZE + sizeof(uint32_t) + static_cast<size_t>(count) * STL_RECORD_SIZE;
+	stats.threads = 1;
+	stats.parseSeconds = secondsSince(start);
+
+	normalize(mesh);
+
+	stats.totalSeconds = secondsSince(start);
+	return true;
+}
+
+/** The scalar types of the PLY properties. */
+enum class PlyType
+{
+	Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64
+};
+
+/** A property of a PLY element; the list properties store the type of their count and of their items. */
+struct PlyProperty
+{
+	/** The name of the property. */
+	string name;
+	/** The type of the value (or of the list items). */
+	PlyType type = PlyType::Float32;
+	/** The type of the list count. */
+	PlyType countType = PlyType::UInt8;
+	/** True if the property is a list. */
+	bool isList = false;
+};
+
+/** An element of the PLY file (e.g., the vertices or the faces). */
+struct PlyElement
+{
+	/** The name of the element. */
+	string name;
+	/** The number of records of the element. */
+	size_t count = 0;
+	/** The properties of each record in the file order. */
+	vector<PlyProperty> properties;
+};
+
+/** Parses the PLY type name (both the original and the sized names are accepted). */
+static bool parsePlyType(const string& name, PlyType& type)
+{
+	static const pair<const char*, PlyType> names[] = {
+		{ "char", PlyType::Int8 }, { "int8", PlyType::Int8 }, { "uchar", PlyType::UInt8 }, { "uint8", PlyType::UInt8 },
+		{ "short", PlyType::Int16 }, { "int16", PlyType::Int16 }, { "ushort", PlyType::UInt16 }, { "uint16", PlyType::UInt16 },
+		{ "int", PlyType::Int32 }, { "int32", PlyType::Int32 }, { "uint", PlyType::UInt32 }, { "uint32", PlyType::UInt32 },
+		{ "float", PlyType::Float32 }, { "float32", PlyType::Float32 }, { "double", PlyType::Float64 }, { "float64", PlyType::Float64 }
+	};
+	for (const auto& entry : names)
+	{
+		if (name == entry.first)
+		{
+			type = entry.second;
+			return true;
+		}
+	}
+	return false;
+}
+
+/** Returns the size of the PLY type in bytes. */
+static size_t plySize(const PlyType type)
+{
+	switch (type)
+	{
+	case PlyType::Int8:
+	case PlyType::UInt8:
+		return 1;
+	case PlyType::Int16:
+	case PlyType::UInt16:
+		return 2;
+	case PlyType::Float64:
+		return 8;
+	default:
+		return 4;
+	}
+}
+
+/** Reads the little-endian value of the given PLY type. */
+static inline double readPly(const char* p, const PlyType type)
+{
+	switch (type)
+	{
+	case PlyType::Int8: { int8_t v; memcpy(&v, p, sizeof(v)); return v; }
+	case PlyType::UInt8: { uint8_t v; memcpy(&v, p, sizeof(v)); return v; }
+	case PlyType::Int16: { int16_t v; memcpy(&v, p, sizeof(v)); return v; }
+	case PlyType::UInt16: { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+	case PlyType::Int32: { int32_t v; memcpy(&v, p, sizeof(v)); return v; }
+	case PlyType::UInt32: { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+	case PlyType::Float32: { float v; memcpy(&v, p, sizeof(v)); return v; }
+	default: { double v; memcpy(&v, p, sizeof(v)); return v; }
+	}
+}
+
+/** Parses the text of the PLY header into its elements; returns false if the file is not a binary little-endian PLY file. */
+static bool parsePlyHeader(const string& path, const string& text, vector<PlyElement>& elements)
+{
+	istringstream lines(text);
+	string line;
+	bool binary = false;
+	while (getline(lines, line))
+	{
+		istringstream words(line);
+		string keyword;
+		words >> keyword;
+		if (keyword == "format")
+		{
+			string format;
+			words >> format;
+			if (format != "binary_little_endian")
+			{
+				cout << "WARNING: " << path << " has the unsupported PLY format " << format << "; only binary_little_endian is supported." << endl;
+				return false;
+			}
+			binary = true;
+		}
+		else if (keyword == "element")
+		{
+			PlyElement element;
+			words >> element.name >> element.count;
+			elements.push_back(element);
+		}
+		else if (keyword == "property" && !elements.empty())
+		{
+			PlyProperty property;
+			string type;
+			words >> type;
+			if (type == "list")
+			{
+				string countType;
+				words >> countType >> type;
+				property.isList = true;
+				if (!parsePlyType(countType, property.countType))
+				{
+					cout << "WARNING: " << path << " has an unsupported PLY property: " << line << endl;
+					return false;
+				}
+			}
+			words >> property.name;
+			if (!parsePlyType(type, property.type) || words.fail())
+			{
+				cout << "WARNING: " << path << " has an unsupported PLY property: " << line << endl;
+				return false;
+			}
+			elements.back().properties.push_back(property);
+		}
+	}
+	return binary;
+}
+
+bool ModelLoader::loadPly(const string& path, MeshData& mesh, LoadStats& stats)
+{
+	const auto start = chrono::steady_clock::now();
+
+	MappedFile file(path);
+	if (!file.isOpen())
+	{
+		return false;
+	}
+
+	const char* first = file.data();
+	const char* last = first + file.size();
+	static const char END_HEADER[] = "end_header";
+	const char* headerEnd = search(first, last, END_HEADER, END_HEADER + sizeof(END_HEADER) - 1);
+	const char* p = find(headerEnd, last, '\n');
+	if (p == last)
+	{
+		cout << "WARNING: " << path << " has no complete PLY header." << endl;
+		return false;
+	}
+	p++;
+
+	vector<PlyElement> elements;
+	if (!parsePlyHeader(path, string(first, headerEnd), elements))
+	{
+		return false;
+	}
+
+	vector<float> positions;
+	size_t invalid = 0;
+	mesh.vertices.clear();
+	mesh.boundingMin = emptyMin();
+	mesh.boundingMax = emptyMax();
+	for (const PlyElement& element : elements)
+	{
+		// the record size of the elements without lists is fixed, so their bounds can be checked at once
+		size_t stride = 0;
+		bool fixed = true;
+		for (const PlyProperty& property : element.properties)
+		{
+			fixed = fixed && !property.isList;
+			stride += plySize(property.type);
+		}
+		if (fixed && stride > 0 && static_cast<size_t>(last - p) / stride < element.count)
+		{
+			cout << "WARNING: " << path << " is truncated." << endl;
+			return false;
+		}
+
+		if (element.name == "vertex" && fixed)
+		{
+			size_t offsets[3] = {};
+			PlyType types[3] = {};
+			int found = 0;
+			size_t offset = 0;
+			for (const PlyProperty& property : element.properties)
+			{
+				const int axis = property.name == "x" ? 0 : property.name == "y" ? 1 : property.name == "z" ? 2 : -1;
+				if (axis >= 0)
+				{
+					offsets[axis] = offset;
+					types[axis] = property.type;
+					found++;
+				}
+				offset += plySize(property.type);
+			}
+			if (found != 3)
+			{
+				cout << "WARNING: " << path << " has no x, y, z vertex properties." << endl;
+				return false;
+			}
+
+			positions.resize(element.count * 3);
+			float* out = positions.data();
+			for (size_t i = 0; i < element.count; i++, p += stride)
+			{
+				*out++ = static_cast<float>(readPly(p + offsets[0], types[0]));
+				*out++ = static_cast<float>(readPly(p + offsets[1], types[1]));
+				*out++ = static_cast<float>(readPly(p + offsets[2], types[2]));
+			}
+		}
+		else if (fixed)
+		{
+			p += stride * element.count;
+		}
+		else
+		{
+			const bool isFace = element.name == "face";
+			const size_t vertexCount = positions.size() / 3;
+			if (isFace)
+			{
+				mesh.vertices.reserve(element.count * 9);
+			}
+			for (size_t i = 0; i < element.count; i++)
+			{
+				for (const PlyProperty& property : element.properties)
+				{
+					const size_t countSize = property.isList ? plySize(property.countType) : 0;
+					if (static_cast<size_t>(last - p) < countSize)
+					{
+						cout << "WARNING: " << path << " is truncated." << endl;
+						return false;
+					}
+					// the count is checked before it is converted, since a negative or huge count does not fit into size_t
+					const double listCount = property.isList ? readPly(p, property.countType) : 1;
+					if (!(listCount >= 0))
+					{
+						cout << "WARNING: " << path << " has a list with a negative or invalid count." << endl;
+						return false;
+					}
+					if (listCount > static_cast<double>(last - p))
+					{
+						cout << "WARNING: " << path << " is truncated." << endl;
+						return false;
+					}
+					const size_t items = static_cast<size_t>(listCount);
+					p += countSize;
+					const size_t itemSize = plySize(property.type);
+					if (static_cast<size_t>(last - p) / itemSize < items)
+					{
+						cout << "WARNING: " << path << " is truncated." << endl;
+						return false;
+					}
+
+					if (isFace && property.isList && (property.name == "vertex_indices" || property.name == "vertex_index"))
+					{
+						// triangulates the polygon as a fan around its first vertex
+						bool valid = items >= 3;
+						for (size_t j = 0; j < items && valid; j++)
+						{
+							const double index = readPly(p + j * itemSize, property.type);
+							valid = index >= 0 && index < vertexCount;
+						}
+						if (valid)
+						{
+							const uint32_t a = static_cast<uint32_t>(readPly(p, property.type));
+							for (size_t j = 2; j < items; j++)
+							{
+								const uint32_t b = static_cast<uint32_t>(readPly(p + (j - 1) * itemSize, property.type));
+								const uint32_t c = static_cast<uint32_t>(readPly(p + j * itemSize, property.type));
+								appendTriangle(mesh.vertices, positions.data(), a, b, c, mesh.boundingMin, mesh.boundingMax);
+							}
+						}
+						else
+						{
+							invalid++;
+						}
+					}
+					p += items * itemSize;
+				}
+			}
+		}
+	}
+
+	if (invalid > 0)
+	{
+		cout << "WARNING: " << invalid << " faces in " << path << " have invalid vertex indices and were skipped." << endl;
+	}
+
+	stats.format = "ply";
+	stats.bytes = file.size();
+	stats.threads = 1;
+	stats.parseSeconds = secondsSince(start);
+
+	normalize(mesh);
+
+	stats.totalSeconds = secondsSince(start);
+	return true;
+}
+
+/** Skips the spaces and tabs (but not the line endings). */
+static inline const char* skipBlanks(const char* p, const char* last)
+{
+	while (p < last && (*p == ' ' || *p == '\t'))
+	{
+		p++;
+	}
+	return p;
+}
+
+/** Returns true if the given line starts with the given single-character statement followed by a blank. */
+static inline bool isStatement(const char* p, const char* last, const char statement)
+{
+	return last - p > 1 && p[0] == statement && (p[1] == ' ' || p[1] == '\t');
+}
+
+bool ModelLoader::loadObj(const string& path, MeshData& mesh, LoadStats& stats)
+{
+	const auto start = chrono::steady_clock::now();
+
+	MappedFile file(path);
+	if (!file.isOpen())
+	{
+		return false;
+	}
+
+	const char* p = file.data();
+	const char* last = p + file.size();
+
+	// the positions must be kept since the faces may refer to any earlier vertex; the polygon buffer is reused by all faces
+	vector<float> positions;
+	vector<uint32_t> polygon;
+	size_t invalid = 0;
+	mesh.vertices.clear();
+	mesh.boundingMin = emptyMin();
+	mesh.boundingMax = emptyMax();
+	while (p < last)
+	{
+		p = skipBlanks(p, last);
+		if (isStatement(p, last, 'v'))
+		{
+			p += 2;
+			float vertex[3];
+			bool valid = true;
+			for (int axis = 0; axis < 3 && valid; axis++)
+			{
+				p = skipBlanks(p, last);
+				if (p < last && *p == '+')
+				{
+					p++;
+				}
+				const from_chars_result result = from_chars(p, last, vertex[axis]);
+				valid = result.ec == errc();
+				p = result.ptr;
+			}
+			if (!valid)
+			{
+				// the vertex keeps its number, since the faces refer to the vertices by their positions in the file, but the faces using it are skipped
+				std::fill(vertex, vertex + 3, numeric_limits<float>::quiet_NaN());
+				invalid++;
+			}
+			positions.insert(positions.end(), vertex, vertex + 3);
+		}
+		else if (isStatement(p, last, 'f'))
+		{
+			p += 2;
+			polygon.clear();
+			const long long vertexCount = static_cast<long long>(positions.size() / 3);
+			bool valid = true;
+			while (true)
+			{
+				p = skipBlanks(p, last);
+				if (p == last || *p == '\r' || *p == '\n')
+				{
+					break;
+				}
+				long long index = 0;
+				const from_chars_result result = from_chars(p, last, index);
+				const long long resolved = index < 0 ? vertexCount + index : index - 1;
+				if (result.ec != errc() || resolved < 0 || resolved >= vertexCount || std::isnan(positions[static_cast<size_t>(resolved) * 3]))
+				{
+					valid = false;
+					break;
+				}
+				polygon.push_back(static_cast<uint32_t>(resolved));
+				// skips the texture and normal indices (v/vt/vn)
+				p = result.ptr;
+				while (p < last && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+				{
+					p++;
+				}
+			}
+
+			if (valid && polygon.size() >= 3)
+			{
+				for (size_t j = 2; j < polygon.size(); j++)
+				{
+					appendTriangle(mesh.vertices, positions.data(), polygon[0], polygon[j - 1], polygon[j], mesh.boundingMin, mesh.boundingMax);
+				}
+			}
+			else
+			{
+				invalid++;
+			}
+		}
+
+		p = find(p, last, '\n');
+		if (p != last)
+		{
+			p++;
+		}
+	}
+
+	if (invalid > 0)
+	{
+		cout << "WARNING: " << invalid << " statements in " << path << " could not be parsed and were skipped (with the faces using a skipped vertex)." << endl;
+	}
+
+	stats.format = "obj";
+	stats.bytes = file.size();
+	stats.threads = 1;
+	stats.parseSeconds = secondsSince(start);
+
+	normalize(mesh);
+
+	stats.totalSeconds = secondsSince(start);
+	return true;
+}
@@ -0,0 +1,217 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "../vecmath/Tuple3f.h"
+
+using namespace std;
+
+/**
+* The triangle geometry loaded from a model file.
+* The vertices are already centered and scaled so the whole model fits into the [-1,1] cube.
+*/
+struct MeshData
+{
+	/** The normalized vertex coordinates, nine floats (three vertices) per triangle. */
+	vector<float> vertices;
+	/** The minimum corner of the bounding box in the original (file) coordinates. */
+	Tuple3f boundingMin;
+	/** The maximum corner of the bounding box in the original (file) coordinates. */
+	Tuple3f boundingMax;
+	/** The center of the original bounding box, i.e., the point that was moved to the origin. */
+	Tuple3f center;
+	/** The scale factor that was applied to the centered vertices. */
+	float scale = 1.f;
+
+	/** Returns the number of complete triangles. */
+	size_t triangleCount() const
+	{
+		return vertices.size() / 9;
+	}
+};
+
+/**
+* The header of the binary mesh file (*.bmesh).
+* The header is followed by triangleCount * 9 normalized float32 vertex coordinates.
+* All values are stored in the little-endian byte order.
+*/
+struct MeshFileHeader
+{
+	/** The identification of the format, always MESH_FILE_MAGIC. */
+	char magic[4];
+	/** The version of the format, currently MESH_FILE_VERSION. */
+	uint32_t version;
+	/** The number of triangles in the payload. */
+	uint32_t triangleCount;
+	/** Reserved for future use, always zero. */
+	uint32_t reserved;
+	/** The minimum corner of the bounding box in the original coordinates. */
+	float boundingMin[3];
+	/** The maximum corner of the bounding box in the original coordinates. */
+	float boundingMax[3];
+	/** The center that was moved to the origin during the normalization. */
+	float center[3];
+	/** The scale that was applied during the normalization. */
+	float scale;
+};
+
+/** The magic bytes identifying the binary mesh file. */
+static const char MESH_FILE_MAGIC[4] = { 'B', 'V', 'H', 'M' };
+/** The current version of the binary mesh file. */
+static const uint32_t MESH_FILE_VERSION = 1;
+/** The extension of the binary mesh files. */
+static const char MESH_FILE_EXTENSION[] = ".bmesh";
+
+/** The statistics of a single model load. */
+struct LoadStats
+{
+	/** The format the model was loaded from. */
+	string format;
+	/** The number of bytes read from the file. */
+	size_t bytes = 0;
+	/** The number of threads that parsed the file. */
+	unsigned threads = 1;
+	/** The time spent reading and parsing the file (in seconds). */
+	double parseSeconds = 0;
+	/** The time spent by the whole load including the normalization (in seconds). */
+	double totalSeconds = 0;
+
+	/** Returns the parse throughput in MB/s. */
+	double throughput() const
+	{
+		return parseSeconds > 0 ? bytes / (1024.0 * 1024.0) / parseSeconds : 0;
+	}
+};
+
+/**
+* Loads the models used by the examples.
+*
+* The *.raw files are plain text files with whitespace separated floats, each line holding one triangle (nine floats).
+* The loader maps the file into the memory and parses it in place with a locale-independent float parser,
+* collecting the bounding box during the parse so the normalization needs only one more pass over the vertices.
+*
+* The binary *.bmesh files already contain the normalized vertices, so they are loaded by a single copy without any parsing.
+*
+* The binary *.stl, binary little-endian *.ply, and *.obj files are imported directly from the mapped file as well.
+* Only the triangles are written into the mesh; polygons are triangulated as fans and everything else
+* (normals, texture coordinates, colors, materials) is skipped without being stored.
+*/
+class ModelLoader
+{
+
+public:
+
+	/**
+	* Loads the model on the given path.
+	* If an up-to-date *.bmesh file with the same name exists next to the given file, it is loaded instead.
+	* The binary files are recognized by their header, so the given path may also point directly to a *.bmesh file.
+	*
+	* @param path		The path to the file.
+	* @param mesh		The mesh that will receive the normalized geometry.
+	* @param stats		The statistics of the load.
+	* @return			{@p true} if the file was loaded; {@p false} if it could not be opened or is not valid.
+	*/
+	static bool load(const string& path, MeshData& mesh, LoadStats& stats);
+
+	/**
+	* Loads the model on the given path from its own format, ignoring any converted *.bmesh file.
+	* The *.bmesh and *.ply files are recognized by their header, the *.stl and *.obj files by their extension,
+	* and all other files are loaded as *.raw files.
+	*
+	* @see load(const string&, MeshData&, LoadStats&)
+	*/
+	static bool loadSource(const string& path, MeshData& mesh, LoadStats& stats);
+
+	/**
+	* Loads the binary *.bmesh file on the given path.
+	*
+	* @see load(const string&, MeshData&, LoadStats&)
+	*/
+	static bool loadBinary(const string& path, MeshData& mesh, LoadStats& stats);
+
+	/**
+	* Saves the mesh into the binary *.bmesh file.
+	*
+	* @param path		The path to the created file.
+	* @param mesh		The normalized mesh.
+	* @return			{@p true} if the file was written.
+	*/
+	static bool saveBinary(const string& path, const MeshData& mesh);
+
+	/** Returns the path of the binary file corresponding to the given model file (the extension is replaced by .bmesh). */
+	static string binaryPath(const string& path);
+
+	/**
+	* Loads the *.raw file on the given path.
+	* Larger files are split into chunks at line boundaries and the chunks are parsed in parallel.
+	*
+	* @param path		The path to the file.
+	* @param mesh		The mesh that will receive the normalized geometry.
+	* @param stats		The statistics of the load.
+	* @param threads	The maximum number of threads used for parsing (0 - one per hardware thread).
+	* @return			{@p true} if the file was loaded (an empty file gives a mesh without triangles); {@p false} if it could not be opened.
+	*/
+	static bool loadRaw(const string& path, MeshData& mesh, LoadStats& stats, unsigned threads = 0);
+
+	/**
+	* Loads the *.raw file through the formatted stream input (ifstream >> float).
+	* This is the original loading path kept as a reference for the benchmark.
+	*
+	* @see loadRaw(const string&, MeshData&, LoadStats&, unsigned)
+	*/
+	static bool loadRawStream(const string& path, MeshData& mesh, LoadStats& stats);
+
+	/**
+	* Loads the binary *.stl file on the given path.
+	* The 50-byte triangle records are copied straight into the mesh; the facet normals and attributes are skipped.
+	*
+	* @see load(const string&, MeshData&, LoadStats&)
+	*/
+	static bool loadStl(const string& path, MeshData& mesh, LoadStats& stats);
+
+	/**
+	* Loads the binary little-endian *.ply file on the given path.
+	* The x, y, z properties of the vertex element and the vertex_indices (or vertex_index) list of the face element are used;
+	* all other elements and properties are skipped.
+	*
+	* @see load(const string&, MeshData&, LoadStats&)
+	*/
+	static bool loadPly(const string& path, MeshData& mesh, LoadStats& stats);
+
+	/**
+	* Loads the *.obj file on the given path.
+	* Only the 'v' and 'f' statements are used; the face indices may be negative (relative) and may carry texture and normal indices.
+	* A 'v' statement that cannot be parsed is dropped together with the faces that use it.
+	*
+	* @see load(const string&, MeshData&, LoadStats&)
+	*/
+	static bool loadObj(const string& path, MeshData& mesh, LoadStats& stats);
+
+	/**
+	* Parses whitespace separated floats from the given text and appends them to the output.
+	* The bounding box of the parsed vertices is updated on the fly.
+	* Each line must hold whole triangles (a multiple of nine floats); a line with a token that is not a float or with a partial triangle is dropped whole,
+	* so the following lines keep their vertices. The text must start at the beginning of a line, so the chunks of a file parse the same as the whole file.
+	* This method is thread-safe as long as each thread uses its own output and bounding box.
+	*
+	* @param first		The first character of the text.
+	* @param last		The character after the last character of the text.
+	* @param out		The array the floats will be appended to.
+	* @param boundingMin	The minimum corner of the bounding box that will be updated.
+	* @param boundingMax	The maximum corner of the bounding box that will be updated.
+	* @return			The number of lines that could not be parsed and were dropped.
+	*/
+	static size_t parseFloats(const char* first, const char* last, vector<float>& out, Tuple3f& boundingMin, Tuple3f& boundingMax);
+
+	/**
+	* Centers the mesh vertices and scales them into the [-1,1] cube using the bounding box stored in the mesh.
+	* Fills the center and scale of the mesh.
+	*/
+	static void normalize(MeshData& mesh);
+
+	/** Returns the empty bounding box minimum (all coordinates are the maximum float). */
+	static Tuple3f emptyMin();
+
+	/** Returns the empty bounding box maximum (all coordinates are the lowest float). */
+	static Tuple3f emptyMax();
+};
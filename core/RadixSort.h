@@ -0,0 +1,94 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "TaskPool.h"
+
+using namespace std;
+
+/**
+* Sorts the keys together with the values by the least significant digit radix sort with 8-bit digits, so the time is linear in the number of keys.
+* Each pass counts the digits of the chunks of the keys in parallel, computes the position of each chunk and digit, and scatters the chunks in parallel;
+* the chunks keep their order, so the sort is stable. The passes in which all keys have the same digit are skipped.
+*
+* @param keys		The keys.
+* @param values		The values moved together with the keys (of the same size).
+* @param bits		The number of the lowest bits of the keys that are sorted by (the higher bits are ignored).
+* @param pool		The threads counting and scattering the chunks (nullptr for the calling thread only).
+*/
+template <typename Key, typename Value>
+void radixSort(vector<Key>& keys, vector<Value>& values, int bits, TaskPool* pool = nullptr)
+{
+	const size_t RADIX = 256;
+	// the chunks should be large enough to amortize the counts of all digits
+	const size_t CHUNK = 64 * 1024;
+	const size_t count = keys.size();
+	const size_t chunks = pool != nullptr ? std::max<size_t>((count + CHUNK - 1) / CHUNK, 1) : 1;
+	const size_t chunkSize = (count + chunks - 1) / chunks;
+
+	vector<Key> sortedKeys(count);
+	vector<Value> sortedValues(count);
+	vector<size_t> offsets(chunks * RADIX);
+	const auto forEachChunk = [&](const auto& function)
+	{
+		if (pool == nullptr)
+		{
+			function(0);
+			return;
+		}
+		pool->parallelFor(0, chunks, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t chunk = begin; chunk < end; chunk++)
+			{
+				function(chunk);
+			}
+		});
+	};
+
+	for (int shift = 0; shift < bits; shift += 8)
+	{
+		std::fill(offsets.begin(), offsets.end(), 0);
+		forEachChunk([&](size_t chunk)
+		{
+			size_t* counts = offsets.data() + chunk * RADIX;
+			const size_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < end; i++)
+			{
+				counts[(keys[i] >> shift) & (RADIX - 1)]++;
+			}
+		});
+
+		// the position of the keys of each digit of each chunk: the digits in order, the chunks in order within each digit
+		size_t position = 0;
+		bool skip = false;
+		for (size_t digit = 0; digit < RADIX; digit++)
+		{
+			for (size_t chunk = 0; chunk < chunks; chunk++)
+			{
+				const size_t digitCount = offsets[chunk * RADIX + digit];
+				offsets[chunk * RADIX + digit] = position;
+				position += digitCount;
+			}
+			skip |= position == count && offsets[digit] == 0;
+		}
+		if (skip)
+		{
+			// all keys have the same digit, so the pass would not change the order
+			continue;
+		}
+
+		forEachChunk([&](size_t chunk)
+		{
+			size_t* positions = offsets.data() + chunk * RADIX;
+			const size_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < end; i++)
+			{
+				const size_t target = positions[(keys[i] >> shift) & (RADIX - 1)]++;
+				sortedKeys[target] = keys[i];
+				sortedValues[target] = values[i];
+			}
+		});
+		keys.swap(sortedKeys);
+		values.swap(sortedValues);
+	}
+}
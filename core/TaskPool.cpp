@@ -0,0 +1,141 @@
+#include "TaskPool.h"
+#include <algorithm>
+
+thread_local int TaskPool::currentQueue = -1;
+thread_local const TaskPool* TaskPool::currentPool = nullptr;
+
+TaskPool::TaskPool(const unsigned threads)
+{
+	const unsigned count = threads != 0 ? threads : std::max(1u, thread::hardware_concurrency());
+	for (unsigned i = 0; i < count; i++)
+	{
+		queues.push_back(make_unique<Queue>());
+	}
+	for (unsigned i = 0; i + 1 < count; i++)
+	{
+		workers.emplace_back(&TaskPool::work, this, i);
+	}
+}
+
+TaskPool::~TaskPool()
+{
+	{
+		lock_guard<mutex> lock(sleepLock);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+size_t TaskPool::queueIndex() const
+{
+	// the threads outside the pool share the last queue
+	return currentPool == this && currentQueue >= 0 ? static_cast<size_t>(currentQueue) : queues.size() - 1;
+}
+
+void TaskPool::run(Group& group, function<void()> task)
+{
+	group.pending++;
+	// counted before it is queued, so the count never drops below the number of queued tasks
+	queued++;
+	Queue& queue = *queues[queueIndex()];
+	{
+		lock_guard<mutex> lock(queue.lock);
+		queue.tasks.emplace_back(std::move(task), &group);
+	}
+	if (!workers.empty())
+	{
+		// the lock orders the notification after the check of a worker going to sleep
+		lock_guard<mutex> lock(sleepLock);
+		wakeUp.notify_one();
+	}
+}
+
+bool TaskPool::runQueuedTask()
+{
+	if (queued == 0)
+	{
+		return false;
+	}
+
+	const size_t own = queueIndex();
+	pair<function<void()>, Group*> task;
+	bool found = false;
+	// the own queue is used as a stack, the others are stolen from as queues
+	for (size_t i = 0; i < queues.size() && !found; i++)
+	{
+		Queue& queue = *queues[(own + i) % queues.size()];
+		lock_guard<mutex> lock(queue.lock);
+		if (!queue.tasks.empty())
+		{
+			if (i == 0)
+			{
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+			else
+			{
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+			found = true;
+		}
+	}
+	if (!found)
+	{
+		return false;
+	}
+
+	queued--;
+	task.first();
+	task.second->pending--;
+	return true;
+}
+
+void TaskPool::wait(Group& group)
+{
+	while (group.pending > 0)
+	{
+		if (!runQueuedTask())
+		{
+			// the remaining tasks of the group are being executed by other threads
+			this_thread::yield();
+		}
+	}
+}
+
+void TaskPool::parallelFor(const size_t first, const size_t last, const size_t grain, const function<void(size_t, size_t)>& function)
+{
+	const size_t step = std::max<size_t>(grain, 1);
+	Group group;
+	for (size_t begin = first; begin < last; begin += step)
+	{
+		const size_t end = std::min(last, begin + step);
+		if (end == last)
+		{
+			// the last range is executed by the calling thread
+			function(begin, end);
+			break;
+		}
+		run(group, [&function, begin, end]() { function(begin, end); });
+	}
+	wait(group);
+}
+
+void TaskPool::work(const size_t index)
+{
+	currentPool = this;
+	currentQueue = static_cast<int>(index);
+	while (!stopping)
+	{
+		if (runQueuedTask())
+		{
+			continue;
+		}
+		unique_lock<mutex> lock(sleepLock);
+		wakeUp.wait(lock, [this]() { return stopping || queued > 0; });
+	}
+}
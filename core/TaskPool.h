@@ -0,0 +1,111 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+* The pool of worker threads executing small tasks with work stealing.
+*
+* Each worker has its own queue; the tasks it submits are pushed to the back of its queue and taken from the back again (the most recent,
+* smallest task first), while the idle workers steal from the front of the other queues (the oldest, largest tasks). The tasks submitted
+* by the threads outside the pool go to an extra shared queue. A thread waiting for its tasks executes the queued tasks meanwhile,
+* so the tasks may wait for the tasks they submitted without blocking a worker.
+*/
+class TaskPool
+{
+
+public:
+
+	/** The number of threads of the new pools (0 - one per hardware thread); set by the --threads option. */
+	inline static unsigned defaultThreads = 0;
+
+	/** The tasks that are waited for together (see wait()). */
+	class Group
+	{
+
+		friend class TaskPool;
+
+		/** The number of the submitted tasks that have not finished yet. */
+		atomic<size_t> pending{ 0 };
+	};
+
+private:
+
+	/** The queue of the tasks of a single thread. */
+	struct Queue
+	{
+		/** Guards the tasks. */
+		mutex lock;
+		/** The tasks together with the groups they belong to. */
+		deque<pair<function<void()>, Group*>> tasks;
+	};
+
+	/** The queues of the workers followed by the queue of the threads outside the pool. */
+	vector<unique_ptr<Queue>> queues;
+	/** The workers. */
+	vector<thread> workers;
+	/** The number of the queued tasks in all queues. */
+	atomic<size_t> queued{ 0 };
+	/** Set when the pool is being destroyed. */
+	atomic<bool> stopping{ false };
+	/** Guards the sleeping of the idle workers. */
+	mutex sleepLock;
+	/** Wakes the idle workers when a task is submitted. */
+	condition_variable wakeUp;
+
+	/** The index of the queue of the current thread, or -1 if it does not belong to the pool (see queueIndex()). */
+	static thread_local int currentQueue;
+	/** The pool the current thread belongs to. */
+	static thread_local const TaskPool* currentPool;
+
+public:
+
+	/**
+	* Starts the workers. The thread that waits for the tasks helps executing them, so a single thread runs all tasks in the calling thread.
+	*
+	* @param threads	The number of threads executing the tasks including the waiting one (0 - one per hardware thread).
+	*/
+	explicit TaskPool(unsigned threads = defaultThreads);
+
+	/** Stops the workers; all submitted tasks must have been waited for. */
+	~TaskPool();
+
+	TaskPool(const TaskPool&) = delete;
+	TaskPool& operator=(const TaskPool&) = delete;
+
+	/** Returns the number of threads executing the tasks, including the waiting one. */
+	unsigned threadCount() const
+	{
+		return static_cast<unsigned>(workers.size()) + 1;
+	}
+
+	/** Submits the task; it is executed by some thread of the pool or by the thread waiting for the group. */
+	void run(Group& group, function<void()> task);
+
+	/** Executes the queued tasks until all tasks of the group have finished. */
+	void wait(Group& group);
+
+	/**
+	* Calls the function for the ranges [begin, end) covering [first, last) in parallel and waits for them.
+	* The ranges have the given size (except the last one), so they may be aligned to the blocks of the data.
+	*/
+	void parallelFor(size_t first, size_t last, size_t grain, const function<void(size_t, size_t)>& function);
+
+private:
+
+	/** Returns the queue the tasks of the current thread are pushed to. */
+	size_t queueIndex() const;
+
+	/** Takes a task from the queue of the current thread or steals one from the others; returns false if all queues are empty. */
+	bool runQueuedTask();
+
+	/** The loop of the worker with the given queue. */
+	void work(size_t index);
+};
@@ -0,0 +1,562 @@
+#pragma once
+#include "../core/Core.h"
+#include "../core/MemoryArena.h"
+#include "../vecmath/Triangle.h"
+#include "../vecmath/TriangleSoA.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+/** A contiguous range of triangle references, e.g., the triangles of a BVH node. */
+class TriangleRange
+{
+
+private:
+
+	/** The first reference of the range. */
+	Triangle* const* first;
+	/** The reference after the last reference of the range. */
+	Triangle* const* last;
+
+public:
+
+	/** Constructs the range of the given references. */
+	TriangleRange(Triangle* const* first = nullptr, Triangle* const* last = nullptr) : first(first), last(last)
+	{
+	}
+
+	/** Returns the first reference of the range. */
+	Triangle* const* begin() const
+	{
+		return first;
+	}
+
+	/** Returns the reference after the last reference of the range. */
+	Triangle* const* end() const
+	{
+		return last;
+	}
+
+	/** Returns the number of triangles in the range. */
+	size_t size() const
+	{
+		return static_cast<size_t>(last - first);
+	}
+
+	/** Returns true if the range contains no triangles. */
+	bool empty() const
+	{
+		return first == last;
+	}
+
+	/** Returns the i-th triangle of the range. */
+	Triangle* operator[](size_t i) const
+	{
+		return first[i];
+	}
+};
+
+enum VolumeType
+{
+	AxisAlignedBoundingBox, Sphere
+};
+
+/** The flag of BVHNode::rightOrCount marking a leaf. */
+static const uint32_t BVH_LEAF_FLAG = 0x80000000u;
+/** The index used when there is no node, e.g., for the parent of the root. */
+static const uint32_t BVH_NO_NODE = 0xFFFFFFFFu;
+
+/**
+ * A single node of the BVH stored in the linear node array of the tree (see BVH).
+ * The node has 32 bytes and is aligned to them, so two nodes share a cache line and a node never crosses one.
+ * The left child of an inner node is always the next node in the array; only the index of the right child is stored.
+ */
+struct alignas(32) BVHNode
+{
+	/** The bounding volume: the minimum and the maximum point of the box, or the center and the radius of the sphere (the rest is zero). */
+	float bounds[6];
+	/** The index of the first triangle reference of the node (of the leftmost leaf for inner nodes). */
+	uint32_t begin;
+	/** BVH_LEAF_FLAG together with the number of triangle references for leaves, the index of the right child for inner nodes. */
+	uint32_t rightOrCount;
+
+	/** Checks if the node is a leaf. */
+	bool isLeaf() const
+	{
+		return (rightOrCount & BVH_LEAF_FLAG) != 0;
+	}
+
+	/** Returns the number of triangle references of the leaf. */
+	uint32_t getCount() const
+	{
+		return rightOrCount & ~BVH_LEAF_FLAG;
+	}
+
+	/** Returns the index of the right child of the inner node. */
+	uint32_t getRight() const
+	{
+		return rightOrCount;
+	}
+
+	/** Returns the minimum point on the bounding box. */
+	Tuple3f getMin() const
+	{
+		return Tuple3f(bounds[0], bounds[1], bounds[2]);
+	}
+
+	/** Returns the maximum point on the bounding box. */
+	Tuple3f getMax() const
+	{
+		return Tuple3f(bounds[3], bounds[4], bounds[5]);
+	}
+
+	/** Returns the center of the bounding sphere. */
+	Tuple3f getCenter() const
+	{
+		return Tuple3f(bounds[0], bounds[1], bounds[2]);
+	}
+
+	/** Returns the radius of the bounding sphere. */
+	float getRadius() const
+	{
+		return bounds[3];
+	}
+
+	/** Sets the bounding box of the node. */
+	void setBox(const Tuple3f& min, const Tuple3f& max)
+	{
+		bounds[0] = min.x;
+		bounds[1] = min.y;
+		bounds[2] = min.z;
+		bounds[3] = max.x;
+		bounds[4] = max.y;
+		bounds[5] = max.z;
+	}
+
+	/** Sets the bounding sphere of the node. */
+	void setSphere(const Tuple3f& center, float radius)
+	{
+		bounds[0] = center.x;
+		bounds[1] = center.y;
+		bounds[2] = center.z;
+		bounds[3] = radius;
+		bounds[4] = 0;
+		bounds[5] = 0;
+	}
+
+	/** Makes the node a leaf referencing the given range of the triangle references. */
+	void setLeaf(uint32_t begin, uint32_t count)
+	{
+		this->begin = begin;
+		rightOrCount = count | BVH_LEAF_FLAG;
+	}
+
+	/** Makes the node an inner node with the given first triangle reference and the given right child. */
+	void setInner(uint32_t begin, uint32_t right)
+	{
+		this->begin = begin;
+		rightOrCount = right;
+	}
+};
+
+static_assert(sizeof(BVHNode) == 32, "two BVH nodes have to fit into a cache line");
+
+/**
+ * The memory occupied by a BVH split into its parts (see BVH::footprint()).
+ * The byte counts of the arrays are their capacities, i.e., the memory they took from the arena of the tree or, if they outgrew it, from the heap.
+ */
+struct BVHFootprint
+{
+	/** The type of the bounding volumes. */
+	VolumeType volumeType = VolumeType::AxisAlignedBoundingBox;
+	/** The number of nodes. */
+	size_t nodeCount = 0;
+	/** The number of leaves. */
+	size_t leafCount = 0;
+	/** The bytes of the node array. */
+	size_t nodeBytes = 0;
+	/** The number of triangle references of the leaves; a triangle crossing a cut is referenced by each leaf it belongs to. */
+	size_t referenceCount = 0;
+	/** The bytes of the triangle reference array. */
+	size_t referenceBytes = 0;
+	/** The number of distinct triangles referenced by the leaves. */
+	size_t uniqueTriangles = 0;
+	/** The bytes of the vertices stored for the references (see TriangleSoA). */
+	size_t triangleStoreBytes = 0;
+	/** The bytes allocated from the arena of the tree (the arrays are never reallocated in it, see reserveGrowth()). */
+	size_t arenaUsedBytes = 0;
+	/** The bytes the arena of the tree obtained from the system. */
+	size_t arenaReservedBytes = 0;
+	/** The bytes the arena of the tree was sized for when the tree was created (see BVH::arenaSize()). */
+	size_t arenaBudgetBytes = 0;
+	/** The bytes of the arrays that outgrew the arena of the tree and moved to the heap (see reserveGrowth()). */
+	size_t heapBytes = 0;
+	/** The bytes of the whole tree (see BVH::memoryBytes()). */
+	size_t totalBytes = 0;
+
+	/** Returns the average number of references per referenced triangle (1 if no triangle is duplicated). */
+	double duplicationFactor() const
+	{
+		return uniqueTriangles != 0 ? static_cast<double>(referenceCount) / uniqueTriangles : 1.0;
+	}
+
+	/** Returns true if the arena of the tree stayed within the bytes it was sized for, i.e., no array was left behind in it by a growing vector. */
+	bool fitsArena() const
+	{
+		return arenaUsedBytes <= arenaBudgetBytes;
+	}
+
+	/** Writes the numbers as the members of a JSON object (without the braces), so the caller can add its own members. */
+	void write(ostream& out) const
+	{
+		out << "\"volume\": \"" << (volumeType == VolumeType::Sphere ? "sphere" : "aabb") << "\""
+			<< ", \"nodes\": " << nodeCount
+			<< ", \"leaves\": " << leafCount
+			<< ", \"nodeBytes\": " << nodeBytes
+			<< ", \"references\": " << referenceCount
+			<< ", \"referenceBytes\": " << referenceBytes
+			<< ", \"uniqueTriangles\": " << uniqueTriangles
+			<< ", \"duplicationFactor\": " << duplicationFactor()
+			<< ", \"triangleStoreBytes\": " << triangleStoreBytes
+			<< ", \"arenaUsedBytes\": " << arenaUsedBytes
+			<< ", \"arenaReservedBytes\": " << arenaReservedBytes
+			<< ", \"arenaBudgetBytes\": " << arenaBudgetBytes
+			<< ", \"heapBytes\": " << heapBytes
+			<< ", \"totalBytes\": " << totalBytes;
+	}
+};
+
+/**
+ * The bounding volume hierarchy (BVH) tree.
+ * The tree is binary and all its nodes are stored in a single array in the depth-first pre-order, so the root is the node 0
+ * and the left child of an inner node is the node following it. The nodes are referred to by their indices in the array.
+ *
+ * The triangles are not stored in the nodes. The tree holds a single array of triangle references in the order of the leaves
+ * and each node references a range of it: a leaf its own triangles and an inner node the range spanning all leaves below it.
+ * A triangle crossing a split plane belongs to several leaves, so it is referenced once per leaf.
+ */
+class BVH
+{
+
+public:
+
+	/** The index of the root node. */
+	static constexpr uint32_t ROOT = 0;
+
+	/** The type of the bounding volumes of all nodes. */
+	VolumeType volumeType;
+	/** The number of bytes the arena was sized for; the arrays outgrowing their estimates move to the heap rather than grow in the arena. */
+	size_t arenaBudget;
+	/** The arena holding the nodes, the triangle references, and their vertices; it is declared first, so it is destroyed after the arrays. */
+	MemoryArena arena;
+	/** The nodes in the depth-first pre-order. */
+	ArenaVector<BVHNode> nodes;
+	/** The triangle references of the whole tree in the order of the leaves. */
+	ArenaVector<Triangle*> references;
+	/** The vertices of the referenced triangles in the order of the references, so the triangles of a leaf are tested in blocks (see TriangleSoA). */
+	TriangleSoA triangles;
+
+	/**
+	* Constructs an empty tree of the given bounding volumes.
+	* All arrays of the tree are taken from its arena, so the tree is released at once by returning the chunks of the arena.
+	*
+	* @param volumeType	The type of the bounding volumes.
+	* @param arenaSize	The expected number of bytes of all arrays; the arena grows if it is exceeded.
+	*/
+	BVH(VolumeType volumeType, size_t arenaSize = MemoryArena::DEFAULT_CHUNK_SIZE)
+		: volumeType(volumeType), arenaBudget(arenaSize), arena(arenaSize), nodes(&arena), references(&arena), triangles(&arena)
+	{
+	}
+
+	// The arrays point into the arena of the tree.
+	BVH(const BVH&) = delete;
+	BVH& operator=(const BVH&) = delete;
+
+	/** Returns the number of nodes of a full tree of the given depth, the most a tree of the depth may have (SIZE_MAX if it exceeds size_t). */
+	static size_t fullTreeNodes(int depth)
+	{
+		if (depth <= 0)
+		{
+			return 0;
+		}
+		return static_cast<size_t>(depth) < sizeof(size_t) * 8 ? (static_cast<size_t>(1) << depth) - 1 : SIZE_MAX;
+	}
+
+	/** Returns the number of bytes the arena needs for the given number of nodes and triangle references (with the 16-bit coordinates if quantized is true). */
+	static size_t arenaSize(size_t nodeCount, size_t referenceCount, bool quantized = false)
+	{
+		// each reference has its pointer and nine coordinates; the coordinate arrays are padded and aligned (see TriangleSoA)
+		const size_t padded = referenceCount + TriangleSoA::LANES;
+		return nodeCount * sizeof(BVHNode) + referenceCount * sizeof(Triangle*) + padded * 9 * (quantized ? sizeof(uint16_t) : sizeof(float)) + 16 * 64;
+	}
+
+	/** Returns the number of nodes. */
+	uint32_t size() const
+	{
+		return static_cast<uint32_t>(nodes.size());
+	}
+
+	/** Returns the given node. */
+	const BVHNode& operator[](uint32_t node) const
+	{
+		return nodes[node];
+	}
+
+	/** Returns the left child of the given inner node. */
+	uint32_t getLeft(uint32_t node) const
+	{
+		return node + 1;
+	}
+
+	/** Returns the right child of the given inner node. */
+	uint32_t getRight(uint32_t node) const
+	{
+		return nodes[node].getRight();
+	}
+
+	/** Returns the triangles referenced by the given node; the range of an inner node ends with its rightmost leaf. */
+	TriangleRange getTriangles(uint32_t node) const
+	{
+		const uint32_t begin = nodes[node].begin;
+		while (!nodes[node].isLeaf())
+		{
+			node = nodes[node].getRight();
+		}
+		Triangle* const* first = references.data();
+		return TriangleRange(first + begin, first + nodes[node].begin + nodes[node].getCount());
+	}
+
+	/**
+	* Appends the nodes of the given tree after the nodes of this tree, so its root becomes the node size(), e.g., a subtree built separately.
+	* The triangle references and their vertices are appended after those of this tree and the indices stored in the appended nodes are shifted.
+	*/
+	void append(const BVH& subtree)
+	{
+		const uint32_t nodeOffset = size();
+		const uint32_t referenceOffset = static_cast<uint32_t>(references.size());
+		reserveGrowth(nodes, nodes.size() + subtree.nodes.size());
+		reserveGrowth(references, references.size() + subtree.references.size());
+		for (BVHNode node : subtree.nodes)
+		{
+			node.begin += referenceOffset;
+			if (!node.isLeaf())
+			{
+				node.setInner(node.begin, node.getRight() + nodeOffset);
+			}
+			nodes.push_back(node);
+		}
+		references.insert(references.end(), subtree.references.begin(), subtree.references.end());
+		triangles.resize(references.size());
+		triangles.copy(subtree.triangles, 0, subtree.references.size(), referenceOffset);
+	}
+
+	/** Returns the parent of each node (BVH_NO_NODE for the root). */
+	vector<uint32_t> getParents() const
+	{
+		vector<uint32_t> parents(nodes.size(), BVH_NO_NODE);
+		for (uint32_t i = 0; i < size(); i++)
+		{
+			if (!nodes[i].isLeaf())
+			{
+				parents[getLeft(i)] = i;
+				parents[getRight(i)] = i;
+			}
+		}
+		return parents;
+	}
+
+	/**
+	* Returns the nodes grouped by their depth, the root first.
+	* The volume of a node depends only on the nodes below it, so the levels are refitted from the deepest one and the nodes of a level in parallel (see BVHExample::refit()).
+	*/
+	vector<vector<uint32_t>> getLevels() const
+	{
+		vector<vector<uint32_t>> levels;
+		// the parents precede their children in the pre-order, so the depth of each node is known when it is reached
+		vector<uint32_t> depths(nodes.size(), 0);
+		for (uint32_t i = 0; i < size(); i++)
+		{
+			if (depths[i] == levels.size())
+			{
+				levels.emplace_back();
+			}
+			levels[depths[i]].push_back(i);
+			if (!nodes[i].isLeaf())
+			{
+				depths[getLeft(i)] = depths[i] + 1;
+				depths[getRight(i)] = depths[i] + 1;
+			}
+		}
+		return levels;
+	}
+
+	/** Returns the number of bytes occupied by the nodes, the triangle references, and their vertices (the whole arena of the tree and the arrays that outgrew it). */
+	size_t memoryBytes() const
+	{
+		return sizeof(BVH) + arena.reservedBytes() + heapBytes();
+	}
+
+	/** Returns the number of bytes of the arrays that outgrew the arena of the tree and moved to the heap. */
+	size_t heapBytes() const
+	{
+		return heapCapacityBytes(nodes) + heapCapacityBytes(references) + triangles.heapBytes();
+	}
+
+	/** Returns the memory of the tree split into its parts; the distinct triangles are counted by sorting a copy of the references. */
+	BVHFootprint footprint() const
+	{
+		BVHFootprint footprint;
+		footprint.volumeType = volumeType;
+		footprint.nodeCount = nodes.size();
+		footprint.leafCount = count_if(nodes.begin(), nodes.end(), [](const BVHNode& node) { return node.isLeaf(); });
+		footprint.nodeBytes = nodes.capacity() * sizeof(BVHNode);
+		footprint.referenceCount = references.size();
+		footprint.referenceBytes = references.capacity() * sizeof(Triangle*);
+
+		vector<Triangle*> sorted(references.begin(), references.end());
+		sort(sorted.begin(), sorted.end());
+		footprint.uniqueTriangles = static_cast<size_t>(unique(sorted.begin(), sorted.end()) - sorted.begin());
+
+		footprint.triangleStoreBytes = triangles.memoryBytes();
+		footprint.arenaUsedBytes = arena.usedBytes();
+		footprint.arenaReservedBytes = arena.reservedBytes();
+		footprint.arenaBudgetBytes = arenaBudget;
+		footprint.heapBytes = heapBytes();
+		footprint.totalBytes = memoryBytes();
+		return footprint;
+	}
+
+	/** Renders the bounding volume of the given node with a specified color. */
+	void render(uint32_t node, Color color, GLfloat matrix[4][4]) const
+	{
+		if (volumeType == VolumeType::Sphere)
+		{
+			renderSphere(nodes[node].getCenter(), nodes[node].getRadius(), color, matrix);
+		}
+		else
+		{
+			renderBox(nodes[node].getMin(), nodes[node].getMax(), color);
+		}
+	}
+
+private:
+
+	/** Renders the bounding box with a specified color. */
+	static void renderBox(const Tuple3f& min, const Tuple3f& max, Color color)
+	{
+		glColor3f(color.r, color.g, color.b);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		glBegin(GL_QUADS);
+		//FRONT
+		glVertex3f(min.x, min.y, max.z);
+		glVertex3f(max.x, min.y, max.z);
+		glVertex3f(max.x, max.y, max.z);
+		glVertex3f(min.x, max.y, max.z);
+		// BACK
+		glVertex3f(min.x, min.y, min.z);
+		glVertex3f(max.x, min.y, min.z);
+		glVertex3f(max.x, max.y, min.z);
+		glVertex3f(min.x, max.y, min.z);
+		// TOP
+		glVertex3f(min.x, min.y, min.z);
+		glVertex3f(min.x, min.y, max.z);
+		glVertex3f(max.x, min.y, max.z);
+		glVertex3f(max.x, min.y, min.z);
+		// BOTTOM
+		glVertex3f(min.x, max.y, min.z);
+		glVertex3f(min.x, max.y, max.z);
+		glVertex3f(max.x, max.y, max.z);
+		glVertex3f(max.x, max.y, min.z);
+		// LEFT
+		glVertex3f(min.x, min.y, min.z);
+		glVertex3f(min.x, max.y, min.z);
+		glVertex3f(min.x, max.y, max.z);
+		glVertex3f(min.x, min.y, max.z);
+		// RIGHT
+		glVertex3f(max.x, min.y, min.z);
+		glVertex3f(max.x, max.y, min.z);
+		glVertex3f(max.x, max.y, max.z);
+		glVertex3f(max.x, min.y, max.z);
+		glEnd();
+	}
+
+	/** Renders the bounding sphere with a specified color; the circle faces the viewer. */
+	static void renderSphere(const Tuple3f& center, float radius, Color color, GLfloat matrix[4][4])
+	{
+		glColor3f(color.r, color.g, color.b);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+
+		int num_segments = 50;
+
+		glPushMatrix();
+		GLfloat transpose[4][4];
+		transpose[0][0] = matrix[0][0];
+		transpose[1][0] = matrix[0][1];
+		transpose[2][0] = matrix[0][2];
+		transpose[3][0] = matrix[0][3];
+
+		transpose[0][1] = matrix[1][0];
+		transpose[1][1] = matrix[1][1];
+		transpose[2][1] = matrix[1][2];
+		transpose[3][1] = matrix[1][3];
+
+		transpose[0][2] = matrix[2][0];
+		transpose[1][2] = matrix[2][1];
+		transpose[2][2] = matrix[2][2];
+		transpose[3][2] = matrix[2][3];
+
+		transpose[0][3] = matrix[3][0];
+		transpose[1][3] = matrix[3][1];
+		transpose[2][3] = matrix[3][2];
+		transpose[3][3] = matrix[3][3];
+
+		glTranslatef(center.x, center.y, center.z);
+
+		/*glBegin(GL_LINE_STRIP);
+		for (int ii = 0; ii < num_segments + 1; ii++) {
+			float theta = 2.0f * 3.1415926f * (float)ii / (float)num_segments;
+
+			float u = radius * (float)cos(theta);
+			float v = radius * (float)sin(theta);
+			glVertex3f(u, v, 0);
+		}
+		glEnd();
+
+		glBegin(GL_LINE_STRIP);
+		for (int ii = 0; ii < num_segments + 1; ii++) {
+			float theta = 2.0f * 3.1415926f * (float)ii / (float)num_segments;
+
+			float u = radius * (float)cos(theta);
+			float v = radius * (float)sin(theta);
+			glVertex3f(u, 0, v);
+		}
+		glEnd();
+
+		glBegin(GL_LINE_STRIP);
+		for (int ii = 0; ii < num_segments + 1; ii++) {
+			float theta = 2.0f * 3.1415926f * (float)ii / (float)num_segments;
+
+			float u = radius * (float)cos(theta);
+			float v = radius * (float)sin(theta);
+			glVertex3f(0, u, v);
+		}
+		glEnd();*/
+
+		glMultMatrixf(&transpose[0][0]);
+
+		glBegin(GL_LINE_STRIP);
+		for (int ii = 0; ii < num_segments + 1; ii++) {
+			float theta = 2.0f * 3.1415926f * (float)ii / (float)num_segments;
+
+			float u = radius * (float)cos(theta);
+			float v = radius * (float)sin(theta);
+			glVertex3f(u, v, 0);
+		}
+		glEnd();
+
+		glPopMatrix();
+	}
+};
@@ -0,0 +1,264 @@
+#include "BVHCache.h"
+#include "../core/MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+const string BVHCache::DIRECTORY = "cache";
+
+/** The magic bytes identifying the cache file. */
+static const char CACHE_FILE_MAGIC[4] = { 'B', 'V', 'H', 'C' };
+/** The version of the cache file layout. */
+static const uint32_t CACHE_FILE_VERSION = 3;
+
+/** The header of the cache file; it is followed by the triangle references of the tree and its node array. */
+struct CacheFileHeader
+{
+	/** The identification of the format, always CACHE_FILE_MAGIC. */
+	char magic[4];
+	/** The version of the format, always CACHE_FILE_VERSION. */
+	uint32_t version;
+	/** The hash of the whole key. */
+	uint64_t keyHash;
+	/** The hash of the mesh. */
+	uint64_t meshHash;
+	/** The hash of the other builder settings. */
+	uint64_t settingsHash;
+	/** The type of the bounding volumes. */
+	uint32_t volumeType;
+	/** The maximum depth of the tree. */
+	int32_t maxDepth;
+	/** The builder version. */
+	uint32_t builderVersion;
+	/** The number of triangles in the mesh. */
+	uint32_t triangleCount;
+	/** The number of bytes following the header. */
+	uint64_t payloadSize;
+	/** The hash of the bytes following the header. */
+	uint64_t checksum;
+};
+
+uint64_t BVHCacheKey::hash() const
+{
+	uint64_t h = BVHCache::hashBytes(&meshHash, sizeof(meshHash));
+	const uint32_t type = static_cast<uint32_t>(volumeType);
+	h = BVHCache::hashBytes(&type, sizeof(type), h);
+	h = BVHCache::hashBytes(&maxDepth, sizeof(maxDepth), h);
+	h = BVHCache::hashBytes(&settingsHash, sizeof(settingsHash), h);
+	return BVHCache::hashBytes(&BVH_BUILDER_VERSION, sizeof(BVH_BUILDER_VERSION), h);
+}
+
+uint64_t BVHCache::hashBytes(const void* data, const size_t size, uint64_t seed)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		seed ^= bytes[i];
+		seed *= 1099511628211ull;
+	}
+	return seed;
+}
+
+uint64_t BVHCache::hashMesh(const IndexedMesh& mesh)
+{
+	const uint64_t h = hashBytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(Tuple3f));
+	return hashBytes(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), h);
+}
+
+string BVHCache::path(const BVHCacheKey& key)
+{
+	stringstream ss;
+	ss << DIRECTORY << "/" << hex << setw(16) << setfill('0') << key.hash() << ".bvh";
+	return ss.str();
+}
+
+/** Appends the bytes of the given value to the buffer. */
+template <typename T>
+static void write(vector<char>& buffer, const T& value)
+{
+	const char* bytes = reinterpret_cast<const char*>(&value);
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+/** Reads the tree from the payload while checking that no read crosses its end. */
+class TreeReader
+{
+
+private:
+
+	/** The current position in the payload. */
+	const char* position;
+	/** The end of the payload. */
+	const char* end;
+	/** The mesh owning the triangles. */
+	IndexedMesh& mesh;
+
+public:
+
+	/** Constructs a reader of the given payload. */
+	TreeReader(const char* first, const char* last, IndexedMesh& mesh) : position(first), end(last), mesh(mesh)
+	{
+	}
+
+	/** Reads the given value; returns false if the payload is too short. */
+	template <typename T>
+	bool read(T& value)
+	{
+		if (static_cast<size_t>(end - position) < sizeof(T))
+		{
+			return false;
+		}
+		memcpy(&value, position, sizeof(T));
+		position += sizeof(T);
+		return true;
+	}
+
+	/** Returns true if the whole payload was read. */
+	bool finished() const
+	{
+		return position == end;
+	}
+
+	/** Reads the triangle references of the tree; returns false if the payload is not valid. */
+	bool readReferences(BVH& tree)
+	{
+		uint32_t count;
+		if (!read(count) || static_cast<size_t>(end - position) / sizeof(uint32_t) < count)
+		{
+			return false;
+		}
+		tree.references.reserve(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t index = 0;
+			read(index);
+			if (index >= mesh.triangleCount())
+			{
+				return false;
+			}
+			tree.references.push_back(&mesh.triangles[index]);
+		}
+		return true;
+	}
+
+	/** Reads the node array of the tree; returns false if the payload is not valid. */
+	bool readNodes(BVH& tree)
+	{
+		uint32_t count;
+		if (!read(count) || count == 0 || static_cast<size_t>(end - position) / sizeof(BVHNode) < count)
+		{
+			return false;
+		}
+		tree.nodes.resize(count);
+		memcpy(tree.nodes.data(), position, count * sizeof(BVHNode));
+		position += count * sizeof(BVHNode);
+
+		// the children always follow their parent, which also rules out cycles
+		const uint32_t references = static_cast<uint32_t>(tree.references.size());
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const BVHNode& node = tree.nodes[i];
+			if (node.begin > references || (node.isLeaf() && node.getCount() > references - node.begin)
+				|| (!node.isLeaf() && (node.getRight() <= i + 1 || node.getRight() >= count)))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+BVH* BVHCache::load(const BVHCacheKey& key, IndexedMesh& mesh)
+{
+	MappedFile file(path(key));
+	if (!file.isOpen() || file.size() < sizeof(CacheFileHeader))
+	{
+		return nullptr;
+	}
+
+	CacheFileHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC)) != 0 || header.version != CACHE_FILE_VERSION
+		|| header.keyHash != key.hash() || header.meshHash != key.meshHash || header.settingsHash != key.settingsHash
+		|| header.volumeType != static_cast<uint32_t>(key.volumeType) || header.maxDepth != key.maxDepth
+		|| header.builderVersion != BVH_BUILDER_VERSION || header.triangleCount != mesh.triangleCount())
+	{
+		return nullptr;
+	}
+
+	const char* payload = file.data() + sizeof(header);
+	if (file.size() - sizeof(header) != header.payloadSize || hashBytes(payload, header.payloadSize) != header.checksum)
+	{
+		cout << "WARNING: the cache file " << path(key) << " is damaged and will be rebuilt." << endl;
+		return nullptr;
+	}
+
+	// the payload starts with the number of references, which sizes the arena of the tree
+	uint32_t referenceCount = 0;
+	memcpy(&referenceCount, payload, std::min<size_t>(sizeof(referenceCount), header.payloadSize));
+	const size_t nodeBytes = header.payloadSize - std::min<uint64_t>(header.payloadSize, 2 * sizeof(uint32_t) + referenceCount * sizeof(uint32_t));
+	BVH* tree = new BVH(key.volumeType, BVH::arenaSize(nodeBytes / sizeof(BVHNode), std::min<size_t>(referenceCount, header.payloadSize / sizeof(uint32_t))));
+	TreeReader reader(payload, payload + header.payloadSize, mesh);
+	if (!reader.readReferences(*tree) || !reader.readNodes(*tree) || !reader.finished())
+	{
+		delete tree;
+		return nullptr;
+	}
+	return tree;
+}
+
+bool BVHCache::save(const BVHCacheKey& key, const BVH* tree, const IndexedMesh& mesh)
+{
+	if (tree == nullptr || tree->size() == 0)
+	{
+		return false;
+	}
+
+	vector<char> payload;
+	write(payload, static_cast<uint32_t>(tree->references.size()));
+	for (Triangle* triangle : tree->references)
+	{
+		write(payload, static_cast<uint32_t>(mesh.indexOf(triangle)));
+	}
+	write(payload, tree->size());
+	const char* nodes = reinterpret_cast<const char*>(tree->nodes.data());
+	payload.insert(payload.end(), nodes, nodes + tree->nodes.size() * sizeof(BVHNode));
+
+	CacheFileHeader header = {};
+	memcpy(header.magic, CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC));
+	header.version = CACHE_FILE_VERSION;
+	header.keyHash = key.hash();
+	header.meshHash = key.meshHash;
+	header.settingsHash = key.settingsHash;
+	header.volumeType = static_cast<uint32_t>(key.volumeType);
+	header.maxDepth = key.maxDepth;
+	header.builderVersion = BVH_BUILDER_VERSION;
+	header.triangleCount = static_cast<uint32_t>(mesh.triangleCount());
+	header.payloadSize = payload.size();
+	header.checksum = hashBytes(payload.data(), payload.size());
+
+	error_code error;
+	filesystem::create_directories(DIRECTORY, error);
+
+	// writes into a temporary file first, so a concurrently starting process never sees a half-written tree
+	const string target = path(key);
+	const string temporary = target + ".tmp";
+	{
+		ofstream file(temporary, ios::binary | ios::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(payload.data(), static_cast<streamsize>(payload.size()));
+		if (!file.good())
+		{
+			return false;
+		}
+	}
+	filesystem::rename(temporary, target, error);
+	return !error;
+}
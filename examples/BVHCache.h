@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "BVH.h"
+#include "../vecmath/IndexedMesh.h"
+
+/**
+* The version of the BVH builder.
+* It is part of the cache key, so it has to be increased whenever BVHExample::construct() starts producing different trees.
+*/
+static const uint32_t BVH_BUILDER_VERSION = 4;
+
+/** The parameters identifying a BVH tree stored in the cache. */
+struct BVHCacheKey
+{
+	/** The hash of the mesh the tree was built from (see BVHCache::hashMesh). */
+	uint64_t meshHash = 0;
+	/** The type of the bounding volumes. */
+	VolumeType volumeType = VolumeType::AxisAlignedBoundingBox;
+	/** The maximum depth of the tree. */
+	int maxDepth = 0;
+	/** The hash of any other builder settings that affect the shape of the tree. */
+	uint64_t settingsHash = 0;
+
+	/** Returns the hash combining all parameters; it is used as the name of the cache file. */
+	uint64_t hash() const;
+};
+
+/**
+* The persistent on-disk cache of constructed BVH trees.
+*
+* Each tree is stored in its own file named after the hash of its key.
+* The file contains the triangle references of the tree (as indices of the triangles in the mesh) and the node array of the tree as it is in memory,
+* and it is protected by a checksum, so damaged or outdated files are detected and the tree is rebuilt.
+*/
+class BVHCache
+{
+
+public:
+
+	/** The directory where the cache files are stored. */
+	static const string DIRECTORY;
+
+	/**
+	* Computes the 64-bit FNV-1a hash of the given bytes.
+	*
+	* @param data		The bytes to hash.
+	* @param size		The number of bytes.
+	* @param seed		The hash of the preceding data if the hash is computed in several steps.
+	*/
+	static uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+	/** Computes the hash of the mesh vertices and indices. */
+	static uint64_t hashMesh(const IndexedMesh& mesh);
+
+	/** Returns the path of the cache file for the given key. */
+	static string path(const BVHCacheKey& key);
+
+	/**
+	* Loads the tree for the given key from the cache.
+	*
+	* @param key		The key of the tree.
+	* @param mesh		The mesh the tree was built from; the tree will reference its triangles.
+	* @return			The loaded tree or {@p nullptr} if the cache does not contain a valid tree.
+	*/
+	static BVH* load(const BVHCacheKey& key, IndexedMesh& mesh);
+
+	/**
+	* Stores the tree into the cache.
+	*
+	* @param key		The key of the tree.
+	* @param tree		The tree.
+	* @param mesh		The mesh owning the triangles referenced by the tree.
+	* @return			{@p true} if the tree was written.
+	*/
+	static bool save(const BVHCacheKey& key, const BVH* tree, const IndexedMesh& mesh);
+};
@@ -13,16 +13,21 @@
 //  Use 'w, a, s, d' to rotate and 'q, e' to move the camera placed in the scene(denoted by the plane with violet arrow).The camera looks away from the plane in the direction of the arrow.
 //  Use 'r' to reset the camera position.
 //  Use 'g' to change the geometry that should be used for building the BVH tree.
+//  Use 'b' to toggle the 16-bit quantized vertices used for building and querying the tree.
+//  Use 'h' to switch the cutting planes of the tree between the midpoint split, the binned SAH with 8, 16, and 32 bins, the SBVH, and the Morton LBVH.
+//  Use 'p' to toggle the partition of the triangles by their centroids, which puts each triangle into a single leaf instead of both children of a cut it crosses.
+//  Use 'n' to switch the traversal of pvs() between the binary tree and the tree collapsed into a BVH4 or BVH8.
+//  Use 'm' to switch to the next model in the models directory; the recently used models stay loaded within the scene memory budget.
+//  The model is loaded and the tree is built in the background; a large model shows a tree of the top levels first, while the final tree is built.
 ///////////////////////////////////////////////////////////
 
 /////////////// Useful methods and code tips. ////////////
-///    Use node->setParent, node->setLeft, and node->setRight methods and their 'get' counterparts to build the tree.
-///    Do not forget to use new operator when creating the nodes.
-///    Use node->getTriangles() to obtain all triangles stored in the node.
-///    Use dynamics_cast to check if the object is of the given instance - if(dynamic_cast<AABB*>(node)).
+///    The nodes are appended to tree->nodes in the depth-first pre-order; the left child of a node is the next node, so only the right child is set (node.setInner).
+///    Use tree->getTriangles(node) to obtain all triangles referenced by the node.
+///    Use tree->volumeType to check which bounding volumes the tree uses.
 //////////////////////////////////////////////////////////
 
-// Defines the raw file that will be loaded.
+// Defines the model file that will be loaded (*.raw, binary *.stl, binary little-endian *.ply, or *.obj).
 //const string BVHExample::PATH = "models/armadillo.raw";
 //const string BVHExample::PATH = "models/beethoven.raw";
 //const string BVHExample::PATH = "models/bunny.raw";
@@ -41,63 +46,96 @@
 const string BVHExample::PATH = "models/womanhead.raw";
 
 /**
-* @param point - point to be compared with current min and max
-* @param curentMM - current min and max (minX, maxX, minY, maxY, minZ, maxZ)
+* @param triangles - set to find min and max x, y, z
 *
-* @return - nothing, currentMM are change if point has bigger extreme
+* @return - tuple with min and max (minX, maxX, minY, maxY, minZ, maxZ), the three coordinates of each point are compared at once (see Vec4)
 **/
-void comparePoint(const Tuple3f & point, std::tuple<float, float, float, float, float, float> & currentMM)
+const std::tuple<float, float, float, float, float, float> findMinsAndMax(const TriangleRange& triangles) 
 {
-	if (point.GetX() < std::get<0>(currentMM)) {
-		std::get<0>(currentMM) = point.GetX();
-	}
-	if (point.GetX() > std::get<1>(currentMM)) {
-		std::get<1>(currentMM) = point.GetX();
-	}
-	if (point.GetY() < std::get<2>(currentMM)) {
-		std::get<2>(currentMM) = point.GetY();
-	}
-	if (point.GetY() > std::get<3>(currentMM)) {
-		std::get<3>(currentMM) = point.GetY();
-	}
-	if (point.GetZ() < std::get<4>(currentMM)) {
-		std::get<4>(currentMM) = point.GetZ();
-	}
-	if (point.GetZ() > std::get<5>(currentMM)) {
-		std::get<5>(currentMM) = point.GetZ();
+	//initialize min and max
+	Vec3 min((*triangles.begin())->v1);
+	Vec3 max = min;
+
+	//find actual min and max
+	for (Triangle* triangle : triangles)
+	{
+		const Vec3 v1(triangle->v1);
+		const Vec3 v2(triangle->v2);
+		const Vec3 v3(triangle->v3);
+		min = Vec4::min(min, Vec4::min(v1, Vec4::min(v2, v3)));
+		max = Vec4::max(max, Vec4::max(v1, Vec4::max(v2, v3)));
 	}
+	return std::make_tuple(min.GetX(), max.GetX(), min.GetY(), max.GetY(), min.GetZ(), max.GetZ());
 }
 
 /**
-* @param triangles - set to find min and max x, y, z
+* @param triangles - vertices of the triangles stored in blocks
+* @param first - first triangle of the range
+* @param last - triangle after the last triangle of the range
 *
-* @return - tuple with min and max (minX, maxX, minY, maxY, minZ, maxZ)
+* @return - tuple with min and max (minX, maxX, minY, maxY, minZ, maxZ), computed for LANES triangles at once
 **/
-const std::tuple<float, float, float, float, float, float> findMinsAndMax(const unordered_set<Triangle*>& triangles) 
+const std::tuple<float, float, float, float, float, float> findMinsAndMax(const TriangleSoA& triangles, size_t first, size_t last)
 {
-	//initialize min and max
-	float minX = (*triangles.begin())->v1.GetX();
-	float maxX = (*triangles.begin())->v1.GetX();
-	float minY = (*triangles.begin())->v1.GetY();
-	float maxY = (*triangles.begin())->v1.GetY();
-	float minZ = (*triangles.begin())->v1.GetZ();
-	float maxZ = (*triangles.begin())->v1.GetZ();
-
-	auto ret = std::make_tuple(minX, maxX, minY, maxY, minZ, maxZ);
+	Tuple3f min;
+	Tuple3f max;
+	triangles.bounds(first, last, min, max);
+	return std::make_tuple(min.x, max.x, min.y, max.y, min.z, max.z);
+}
 
-	//find actual min and max
-	for (Triangle* triangle : triangles)
-	{	
-		//check 1st point
-		comparePoint(triangle->v1, ret);
+/**
+* @param first - box of the first triangle of the range
+* @param last - box after the box of the last triangle of the range
+*
+* @return - tuple with min and max (minX, maxX, minY, maxY, minZ, maxZ) of the boxes
+**/
+const std::tuple<float, float, float, float, float, float> findMinsAndMax(const TriangleBox* first, const TriangleBox* last)
+{
+	float min[3] = { INFINITY, INFINITY, INFINITY };
+	float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for (const TriangleBox* box = first; box != last; box++)
+	{
+		for (int coordinate = 0; coordinate < 3; coordinate++)
+		{
+			min[coordinate] = std::min(min[coordinate], box->min[coordinate]);
+			max[coordinate] = std::max(max[coordinate], box->max[coordinate]);
+		}
+	}
+	return std::make_tuple(min[0], max[0], min[1], max[1], min[2], max[2]);
+}
 
-		//check 2nd point
-		comparePoint(triangle->v2, ret);
+/**
+* @param work - triangles of the tree being built
+* @param first - first triangle of the range
+* @param last - triangle after the last triangle of the range
+*
+* @return - tuple with min and max (minX, maxX, minY, maxY, minZ, maxZ); the large ranges are split among the threads of the builder
+**/
+const std::tuple<float, float, float, float, float, float> findMinsAndMax(const BVHBuildWork& work, size_t first, size_t last)
+{
+	if (!work.boxes.empty())
+	{
+		//the spatial splits clipped the triangles, so the node bounds only their parts inside it
+		return findMinsAndMax(work.boxes.data() + first, work.boxes.data() + last);
+	}
+	if (work.pool == nullptr || last - first < 2 * BVHBuildWork::PASS_GRAIN)
+	{
+		return findMinsAndMax(work.store, first, last);
+	}
 
-		//check 3rd point
-		comparePoint(triangle->v3, ret);
+	vector<std::tuple<float, float, float, float, float, float>> parts((last - first + BVHBuildWork::PASS_GRAIN - 1) / BVHBuildWork::PASS_GRAIN);
+	work.pool->parallelFor(first, last, BVHBuildWork::PASS_GRAIN, [&](size_t begin, size_t end)
+	{
+		parts[(begin - first) / BVHBuildWork::PASS_GRAIN] = findMinsAndMax(work.store, begin, end);
+	});
+	auto result = parts[0];
+	for (const auto& part : parts)
+	{
+		result = std::make_tuple(std::min(std::get<0>(result), std::get<0>(part)), std::max(std::get<1>(result), std::get<1>(part)),
+			std::min(std::get<2>(result), std::get<2>(part)), std::max(std::get<3>(result), std::get<3>(part)),
+			std::min(std::get<4>(result), std::get<4>(part)), std::max(std::get<5>(result), std::get<5>(part)));
 	}
-	return ret;
+	return result;
 }
 
 /**
@@ -106,7 +144,7 @@ const std::tuple<float, float, float, float, float, float> findMinsAndMax(const
 * 
 * @return - furthest vertex from vertex1
 **/
-const Tuple3f findFurthestVertex(const Tuple3f vertex1, const unordered_set<Triangle*>& triangles)
+const Tuple3f findFurthestVertex(const Tuple3f vertex1, const TriangleRange& triangles)
 {
 	Tuple3f vertex2 = (*triangles.begin())->v1;
 	float maxDistance = vertex1.distance(vertex1, vertex2);
@@ -145,7 +183,7 @@ const Tuple3f findFurthestVertex(const Tuple3f vertex1, const unordered_set<Tria
 *
 * @return - std::tuple<center, riadial>
 **/
-const std::tuple<Tuple3f, float> computeSphere(const unordered_set<Triangle*>& triangles)
+const std::tuple<Tuple3f, float> computeSphere(const TriangleRange& triangles)
 {
 	//compute bounding sphere from "AABB" box
 	auto box = findMinsAndMax(triangles);
@@ -198,14 +236,14 @@ const std::tuple<Tuple3f, float> computeSphere(const unordered_set<Triangle*>& t
 }
 
 /*
-* @param AABB - bounding box
+* @param parent - node with the bounding box
 *
 * @return - std::tuple<which axis, where>
 *			0 - cut x axis
 *			1 - cut y axis
 *			2 - cut z axis
 **/
-std::tuple<int, float> howShouldICut(const AABB & parent)
+std::tuple<int, float> howShouldICut(const BVHNode& parent)
 {
 	Tuple3f min = parent.getMin();
 	Tuple3f max = parent.getMax();
@@ -239,9 +277,9 @@ std::tuple<int, float> howShouldICut(const AABB & parent)
 	return std::make_tuple(axisIndex, axisPosition);
 }
 
-std::tuple<int, float> howShouldICut(const BSV& parent)
+std::tuple<int, float> howShouldICut(const BVHNode& parent, const BVHBuildWork& work, size_t first, size_t last)
 {
-	auto minmax = findMinsAndMax(parent.triangles);
+	auto minmax = findMinsAndMax(work, first, last);
 
 	float xAxisSize = std::get<1>(minmax) - std::get<0>(minmax);
 	float yAxisSize = std::get<3>(minmax) - std::get<2>(minmax);
@@ -272,134 +310,975 @@ std::tuple<int, float> howShouldICut(const BSV& parent)
 	return std::make_tuple(axisIndex, axisPosition);
 }
 
+void BoxVolume::bound(BVHNode& node, const BVHBuildWork& work, size_t first, size_t last)
+{
+	auto borders = findMinsAndMax(work, first, last);
+
+	//the store holds the dequantized vertices in the quantized mode, so the box is enlarged to contain the original ones
+	const Tuple3f error = work.store.getErrorBound();
+	node.setBox(Tuple3f(std::get<0>(borders) - error.x, std::get<2>(borders) - error.y, std::get<4>(borders) - error.z),
+		Tuple3f(std::get<1>(borders) + error.x, std::get<3>(borders) + error.y, std::get<5>(borders) + error.z));
+}
+
+void BoxVolume::bound(BVHNode& leaf, const BVH& tree)
+{
+	auto borders = findMinsAndMax(tree.triangles, leaf.begin, leaf.begin + leaf.getCount());
+
+	const Tuple3f error = tree.triangles.getErrorBound();
+	leaf.setBox(Tuple3f(std::get<0>(borders) - error.x, std::get<2>(borders) - error.y, std::get<4>(borders) - error.z),
+		Tuple3f(std::get<1>(borders) + error.x, std::get<3>(borders) + error.y, std::get<5>(borders) + error.z));
+}
 
-std::tuple<unordered_set<Triangle*>, unordered_set<Triangle*>> cutModel(BVH & parent)
+std::tuple<int, float> BoxVolume::split(const BVHNode& node, const BVHBuildWork&, size_t, size_t)
 {
-	std::tuple<int, float> cuttingPosition;
-	if (AABB* aabb = dynamic_cast<AABB*>(&parent))
+	return howShouldICut(node);
+}
+
+void SphereVolume::bound(BVHNode& node, const BVHBuildWork& work, size_t first, size_t last)
+{
+	auto sphereTuple = computeSphere(TriangleRange(work.triangles.data() + first, work.triangles.data() + last));
+
+	node.setSphere(std::get<0>(sphereTuple), std::get<1>(sphereTuple));
+}
+
+void SphereVolume::bound(BVHNode& leaf, const BVH& tree)
+{
+	auto sphereTuple = computeSphere(TriangleRange(tree.references.data() + leaf.begin, tree.references.data() + leaf.begin + leaf.getCount()));
+
+	leaf.setSphere(std::get<0>(sphereTuple), std::get<1>(sphereTuple));
+}
+
+std::tuple<int, float> SphereVolume::split(const BVHNode& node, const BVHBuildWork& work, size_t first, size_t last)
+{
+	return howShouldICut(node, work, first, last);
+}
+
+
+/** Returns the surface area of the box of the bin. */
+float surfaceArea(const TriangleBin& bin)
+{
+	const float x = bin.max[0] - bin.min[0];
+	const float y = bin.max[1] - bin.min[1];
+	const float z = bin.max[2] - bin.min[2];
+	return 2 * (x * y + y * z + z * x);
+}
+
+/**
+* The surface area heuristic estimates the cost of the traversal of the children as the number of their triangles weighted by the surface
+* of their boxes, which is proportional to the probability that a random plane hits them. The centroids of the triangles are sorted into
+* work.binCount bins along each axis and the planes between the bins are evaluated; unless the triangles are partitioned by their centroids,
+* the triangles crossing the chosen plane are still sent to both children by cutModel(), so the cost is only an estimate.
+*
+* @param work - triangles of the tree being built
+* @param first - first triangle of the node
+* @param last - triangle after the last triangle of the node
+* @param cut - receives std::tuple<which axis, where> of the cheapest plane
+* @param cost - receives the estimated cost of the node cut by the plane relative to the cost of a leaf (1 or more if the cut does not pay off)
+*
+* @return - false if all centroids coincide, so there is no plane between them
+**/
+bool howShouldICutBySAH(BVHBuildWork& work, size_t first, size_t last, std::tuple<int, float>& cut, float& cost)
+{
+	Tuple3f min, max;
+	work.store.centroidBounds(first, last, min, max);
+	const float low[3] = { min.x, min.y, min.z };
+	const float high[3] = { max.x, max.y, max.z };
+
+	const int binCount = std::max(work.binCount, 2);
+	work.bins.resize(binCount);
+	work.binCosts.resize(binCount);
+	float bestCost = INFINITY;
+	float nodeArea = 0;
+	for (int axis = 0; axis < 3; axis++)
 	{
-		cuttingPosition = howShouldICut(*aabb);
+		const float extent = high[axis] - low[axis];
+		if (!(extent > 0))
+		{
+			continue;
+		}
+		const float scale = binCount / extent;
+		work.store.bin(first, last, axis, low[axis], scale, binCount, work.bins.data());
+
+		//the right side of the plane after each bin is accumulated from the right and the left side from the left
+		TriangleBin side = { 0, { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY } };
+		for (int i = binCount - 1; i > 0; i--)
+		{
+			const TriangleBin& bin = work.bins[i];
+			side.count += bin.count;
+			for (int coordinate = 0; coordinate < 3; coordinate++)
+			{
+				side.min[coordinate] = std::min(side.min[coordinate], bin.min[coordinate]);
+				side.max[coordinate] = std::max(side.max[coordinate], bin.max[coordinate]);
+			}
+			work.binCosts[i - 1] = side.count > 0 ? surfaceArea(side) * side.count : INFINITY;
+		}
+
+		side = { 0, { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY } };
+		for (int i = 0; i < binCount - 1; i++)
+		{
+			const TriangleBin& bin = work.bins[i];
+			side.count += bin.count;
+			for (int coordinate = 0; coordinate < 3; coordinate++)
+			{
+				side.min[coordinate] = std::min(side.min[coordinate], bin.min[coordinate]);
+				side.max[coordinate] = std::max(side.max[coordinate], bin.max[coordinate]);
+			}
+			if (side.count == 0)
+			{
+				continue;
+			}
+			const float cost = surfaceArea(side) * side.count + work.binCosts[i];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				cut = std::make_tuple(axis, low[axis] + (i + 1) / scale);
+			}
+		}
+
+		//the bins together hold all triangles, so their box is the box of the node
+		const TriangleBin& lastBin = work.bins[binCount - 1];
+		for (int coordinate = 0; coordinate < 3; coordinate++)
+		{
+			side.min[coordinate] = std::min(side.min[coordinate], lastBin.min[coordinate]);
+			side.max[coordinate] = std::max(side.max[coordinate], lastBin.max[coordinate]);
+		}
+		nodeArea = surfaceArea(side);
 	}
-	else if (BSV* bsv = dynamic_cast<BSV*>(&parent)) 
+
+	//the leaf tests all its triangles, the inner node tests its volume and then the triangles of the children hit with the probability of their surfaces
+	cost = nodeArea > 0 ? (BVHBuildWork::NODE_COST * nodeArea + bestCost) / (nodeArea * (last - first)) : INFINITY;
+	return bestCost < INFINITY;
+}
+
+/**
+* @param work - triangles of the tree being built
+* @param first - first triangle of the node
+* @param last - triangle after the last triangle of the node
+* @param cut - receives std::tuple<which axis, where> of the plane halving the longest axis of the box of the centroids
+*
+* @return - false if all centroids coincide, so there is no plane between them
+**/
+bool howShouldICutByCentroids(const BVHBuildWork& work, size_t first, size_t last, std::tuple<int, float>& cut)
+{
+	//the box of the triangles may be halved by a plane all centroids lie on one side of, the box of the centroids never is
+	Tuple3f min, max;
+	work.store.centroidBounds(first, last, min, max);
+	const float extent[3] = { max.x - min.x, max.y - min.y, max.z - min.z };
+	const int axis = extent[0] >= extent[1] && extent[0] >= extent[2] ? 0 : extent[1] >= extent[2] ? 1 : 2;
+	if (!(extent[axis] > 0))
 	{
-		cuttingPosition = howShouldICut(*bsv);
+		return false;
 	}
+	const float low[3] = { min.x, min.y, min.z };
+	cut = std::make_tuple(axis, low[axis] + extent[axis] / 2);
+	return true;
+}
 
-	int axisIndex = std::get<0>(cuttingPosition);
-	float axisPosition = std::get<1>(cuttingPosition);
+/**
+* @param work - triangles of the tree being built
+* @param first - first triangle of the node
+* @param last - triangle after the last triangle of the node
+*
+* @return - nothing, the triangles and their vertices are reordered by their sides (0, 1, 2, 3) keeping their order within each side
+*           and the triangles on both sides and on the right side are also appended to the end of the work arrays for the right child
+**/
+void sortBySide(BVHBuildWork& work, size_t first, size_t last)
+{
+	const size_t count = last - first;
+	size_t offsets[4] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		offsets[work.sides[i]]++;
+	}
+	const size_t leftOnly = offsets[0];
+	const size_t rightCount = offsets[1] + offsets[2];
+	size_t offset = 0;
+	for (size_t& sideOffset : offsets)
+	{
+		const size_t sideCount = sideOffset;
+		sideOffset = offset;
+		offset += sideCount;
+	}
 
-	unordered_set<Triangle*> leftSet;
-	unordered_set<Triangle*> rightSet;
+	work.targets.resize(count);
+	work.reordered.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const uint32_t target = static_cast<uint32_t>(offsets[work.sides[i]]++);
+		work.targets[i] = target;
+		work.reordered[target] = work.triangles[first + i];
+	}
+	std::copy(work.reordered.begin(), work.reordered.end(), work.triangles.begin() + first);
 
-	for(auto triangle : parent.getTriangles())
+	//the right child gets its own copy of the crossing and right triangles, so the left child can reorder its part in place
+	//the copies may outgrow the space reserved for them, and the arrays then move to the heap rather than leave their old memory in the arena
+	const size_t rightFirst = work.triangles.size();
+	reserveGrowth(work.triangles, rightFirst + rightCount);
+	work.triangles.insert(work.triangles.end(), work.reordered.begin() + leftOnly, work.reordered.begin() + leftOnly + rightCount);
+	work.store.resize(rightFirst + rightCount);
+	work.store.permute(first, last, work.targets.data(), leftOnly, rightCount, rightFirst);
+
+	if (!work.boxes.empty())
 	{
-		switch (axisIndex)
+		//the boxes follow their triangles; the copies of the triangles crossing a spatial split get the boxes of their parts above the plane
+		work.reorderedBoxes.resize(count);
+		for (size_t i = 0; i < count; i++)
 		{
-		case(0):
-			if (triangle->v1.x > axisPosition || triangle->v2.x > axisPosition || triangle->v3.x > axisPosition)
+			work.reorderedBoxes[work.targets[i]] = work.boxes[first + i];
+		}
+		std::copy(work.reorderedBoxes.begin(), work.reorderedBoxes.end(), work.boxes.begin() + first);
+		reserveGrowth(work.boxes, rightFirst + rightCount);
+		work.boxes.resize(rightFirst + rightCount);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (work.sides[i] == 1 || work.sides[i] == 2)
+			{
+				work.boxes[rightFirst + work.targets[i] - leftOnly] = work.sides[i] == 1 ? work.splitBoxes[i] : work.reorderedBoxes[work.targets[i]];
+			}
+		}
+	}
+}
+
+/** Returns the surface area of the box. */
+float surfaceArea(const TriangleBox& box)
+{
+	const float x = box.max[0] - box.min[0];
+	const float y = box.max[1] - box.min[1];
+	const float z = box.max[2] - box.min[2];
+	return 2 * (x * y + y * z + z * x);
+}
+
+/** Returns true if the box is inverted, i.e., no part of the triangle is inside it (see TriangleSoA::split()). */
+bool isEmpty(const TriangleBox& box)
+{
+	return !(box.min[0] <= box.max[0] && box.min[1] <= box.max[1] && box.min[2] <= box.max[2]);
+}
+
+/** Enlarges the bin by the box (or by another bin). */
+template <class Box>
+void grow(TriangleBin& bin, const Box& box)
+{
+	for (int coordinate = 0; coordinate < 3; coordinate++)
+	{
+		bin.min[coordinate] = std::min(bin.min[coordinate], box.min[coordinate]);
+		bin.max[coordinate] = std::max(bin.max[coordinate], box.max[coordinate]);
+	}
+}
+
+/**
+* The SBVH (the spatial split BVH) chooses between two kinds of cuts by the binned SAH (see howShouldICutBySAH()). The partitions put each triangle
+* into the child of the center of its box, so the children may overlap. The spatial splits cut the space instead: the triangles crossing the plane are
+* referenced by both children, but each child bounds only the part of the triangle on its side, so the boxes of the long thin triangles shrink.
+* The triangles spanning several spatial bins are clipped at the planes between the bins, so each bin bounds only the parts inside it.
+* The spatial splits are tried only if the children of the best partition overlap and the duplicated triangles fit into the budget of the subtree.
+*
+* @param work - triangles of the tree being built and the boxes of their parts
+* @param first - first triangle of the node
+* @param last - triangle after the last triangle of the node
+* @param cut - receives std::tuple<which axis, where, true for the spatial split> of the cheapest cut
+* @param cost - receives the estimated cost of the node cut by the plane relative to the cost of a leaf (1 or more if the cut does not pay off)
+*
+* @return - false if no cut separates the triangles
+**/
+bool howShouldICutSpatially(BVHBuildWork& work, size_t first, size_t last, std::tuple<int, float, bool>& cut, float& cost)
+{
+	const size_t count = last - first;
+	const TriangleBox* boxes = work.boxes.data() + first;
+	const TriangleBin empty = { 0, { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY } };
+	TriangleBin node = empty;
+	TriangleBin centers = empty;
+	for (size_t i = 0; i < count; i++)
+	{
+		grow(node, boxes[i]);
+		for (int coordinate = 0; coordinate < 3; coordinate++)
+		{
+			const float center = (boxes[i].min[coordinate] + boxes[i].max[coordinate]) / 2;
+			centers.min[coordinate] = std::min(centers.min[coordinate], center);
+			centers.max[coordinate] = std::max(centers.max[coordinate], center);
+		}
+	}
+
+	const int binCount = std::max(work.binCount, 2);
+	work.bins.resize(binCount);
+	work.binCosts.resize(binCount);
+	work.binExits.resize(binCount);
+	float bestCost = INFINITY;
+	//the partitions count each triangle in the bin of its center, the spatial splits in the bins where its box starts (bins) and ends (binExits)
+	const auto sweep = [&](int axis, float origin, float scale, bool spatial)
+	{
+		TriangleBin side = empty;
+		for (int i = binCount - 1; i > 0; i--)
+		{
+			grow(side, work.bins[i]);
+			side.count += spatial ? work.binExits[i] : work.bins[i].count;
+			work.binCosts[i - 1] = side.count > 0 ? surfaceArea(side) * side.count : INFINITY;
+		}
+
+		side = empty;
+		size_t leftOnly = 0;
+		for (int i = 0; i < binCount - 1; i++)
+		{
+			grow(side, work.bins[i]);
+			side.count += work.bins[i].count;
+			leftOnly += spatial ? work.binExits[i] : work.bins[i].count;
+			if (side.count == 0 || (spatial && side.count - leftOnly > work.spatialBudget))
 			{
-				rightSet.insert(triangle);
+				continue;
 			}
-			if (triangle->v1.x < axisPosition || triangle->v2.x < axisPosition || triangle->v3.x < axisPosition)
+			const float cost = surfaceArea(side) * side.count + work.binCosts[i];
+			if (cost < bestCost)
 			{
-				leftSet.insert(triangle);
+				bestCost = cost;
+				cut = std::make_tuple(axis, origin + (i + 1) / scale, spatial);
 			}
-			break;
-		case(1):
-			if (triangle->v1.y > axisPosition || triangle->v2.y > axisPosition || triangle->v3.y > axisPosition)
+		}
+	};
+	const auto binOf = [binCount](float value, float origin, float scale)
+	{
+		return std::min(std::max(static_cast<int>((value - origin) * scale), 0), binCount - 1);
+	};
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float extent = centers.max[axis] - centers.min[axis];
+		if (!(extent > 0))
+		{
+			continue;
+		}
+		const float scale = binCount / extent;
+		std::fill(work.bins.begin(), work.bins.end(), empty);
+		for (size_t i = 0; i < count; i++)
+		{
+			TriangleBin& bin = work.bins[binOf((boxes[i].min[axis] + boxes[i].max[axis]) / 2, centers.min[axis], scale)];
+			bin.count++;
+			grow(bin, boxes[i]);
+		}
+		sweep(axis, centers.min[axis], scale, false);
+	}
+
+	//the overlap of the children of the best partition decides whether the spatial splits are worth the time
+	float overlap = INFINITY;
+	if (bestCost < INFINITY)
+	{
+		TriangleBin left = empty;
+		TriangleBin right = empty;
+		const int axis = std::get<0>(cut);
+		for (size_t i = 0; i < count; i++)
+		{
+			grow((boxes[i].min[axis] + boxes[i].max[axis]) / 2 < std::get<1>(cut) ? left : right, boxes[i]);
+		}
+		float extent[3];
+		for (int coordinate = 0; coordinate < 3; coordinate++)
+		{
+			extent[coordinate] = std::max(std::min(left.max[coordinate], right.max[coordinate]) - std::max(left.min[coordinate], right.min[coordinate]), 0.f);
+		}
+		overlap = 2 * (extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0]);
+	}
+
+	if (work.spatialBudget > 0 && overlap > BVHBuildWork::SPATIAL_OVERLAP * work.rootArea)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float extent = node.max[axis] - node.min[axis];
+			if (!(extent > 0))
 			{
-				rightSet.insert(triangle);
+				continue;
 			}
-			if (triangle->v1.y < axisPosition || triangle->v2.y < axisPosition || triangle->v3.y < axisPosition)
+			const float scale = binCount / extent;
+			std::fill(work.bins.begin(), work.bins.end(), empty);
+			std::fill(work.binExits.begin(), work.binExits.end(), 0);
+			for (size_t i = 0; i < count; i++)
 			{
-				leftSet.insert(triangle);
+				const int firstBin = binOf(boxes[i].min[axis], node.min[axis], scale);
+				const int lastBin = binOf(boxes[i].max[axis], node.min[axis], scale);
+				work.bins[firstBin].count++;
+				work.binExits[lastBin]++;
+
+				//the part of the triangle is clipped at each plane it crosses, the rest goes on to the next bin
+				TriangleBox part = boxes[i];
+				for (int bin = firstBin; bin < lastBin; bin++)
+				{
+					TriangleBox left, right;
+					work.store.split(first + i, part, axis, node.min[axis] + (bin + 1) / scale, left, right);
+					if (!isEmpty(left))
+					{
+						grow(work.bins[bin], left);
+					}
+					part = right;
+				}
+				if (!isEmpty(part))
+				{
+					grow(work.bins[lastBin], part);
+				}
 			}
-			break;
-		case(2):
-			if (triangle->v1.z > axisPosition || triangle->v2.z > axisPosition || triangle->v3.z > axisPosition)
+			sweep(axis, node.min[axis], scale, true);
+		}
+	}
+
+	const float nodeArea = surfaceArea(node);
+	cost = nodeArea > 0 ? (BVHBuildWork::NODE_COST * nodeArea + bestCost) / (nodeArea * count) : INFINITY;
+	return bestCost < INFINITY;
+}
+
+/**
+* @param work - triangles of the tree being built and the boxes of their parts
+* @param first - first triangle of the node
+* @param last - triangle after the last triangle of the node
+*
+* @return - std::tuple<left only, both sides, right only> numbers of triangles (see cutModel()); the triangles crossing a spatial split keep the boxes
+*           of their parts below the plane and their copies for the right child get the boxes of the parts above it
+**/
+std::tuple<size_t, size_t, size_t> cutModelSpatially(BVHBuildWork& work, size_t first, size_t last)
+{
+	const size_t count = last - first;
+	std::tuple<int, float, bool> cut;
+	float cost = 0;
+	if (!howShouldICutSpatially(work, first, last, cut, cost) || cost >= 1)
+	{
+		return std::make_tuple(count, static_cast<size_t>(0), static_cast<size_t>(0));
+	}
+
+	const int axis = std::get<0>(cut);
+	const float position = std::get<1>(cut);
+	const bool spatial = std::get<2>(cut);
+	work.splitBoxes.resize(count);
+	size_t counts[4] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		TriangleBox& box = work.boxes[first + i];
+		uint8_t side = 0;
+		if (!spatial)
+		{
+			side = (box.min[axis] + box.max[axis]) / 2 < position ? 0 : 2;
+		}
+		else if (box.max[axis] <= position)
+		{
+			side = 0;
+		}
+		else if (box.min[axis] >= position)
+		{
+			side = 2;
+		}
+		else
+		{
+			const TriangleBox whole = box;
+			TriangleBox left, right;
+			work.store.split(first + i, whole, axis, position, left, right);
+			if (isEmpty(left) && isEmpty(right))
 			{
-				rightSet.insert(triangle);
+				//both parts vanished in the rounding, so both copies keep the whole box
+				side = 1;
+				work.splitBoxes[i] = whole;
 			}
-			if (triangle->v1.z < axisPosition || triangle->v2.z < axisPosition || triangle->v3.z < axisPosition)
+			else if (isEmpty(left) || isEmpty(right))
 			{
-				leftSet.insert(triangle);
+				//the box crosses the plane, but the part of the triangle inside it lies on one side only
+				side = isEmpty(left) ? 2 : 0;
+				box = isEmpty(left) ? right : left;
 			}
-			break;
-		default:
-			break;
+			else
+			{
+				side = 1;
+				box = left;
+				work.splitBoxes[i] = right;
+			}
+		}
+		work.sides[i] = side;
+		counts[side]++;
+	}
+	sortBySide(work, first, last);
+	return std::make_tuple(counts[0], counts[1], counts[2]);
+}
+
+/**
+* @param parent - node being cut
+* @param work - triangles of the tree being built
+* @param first - first triangle of the node
+* @param last - triangle after the last triangle of the node
+*
+* @return - std::tuple<left only, both sides, right only> numbers of triangles; the triangles of the right child are appended to the work arrays (see sortBySide())
+*           and all triangles are left only if the SAH finds that the cut does not pay off or if all centroids of the partitioned triangles coincide,
+*           so the node stays a leaf
+**/
+template <class Volume>
+std::tuple<size_t, size_t, size_t> cutModel(const BVHNode& parent, BVHBuildWork& work, size_t first, size_t last)
+{
+	if (work.splitMethod == SplitMethod::Spatial)
+	{
+		return cutModelSpatially(work, first, last);
+	}
+	const auto leaf = std::make_tuple(last - first, static_cast<size_t>(0), static_cast<size_t>(0));
+	std::tuple<int, float> cuttingPosition;
+	float cost = 0;
+	if (work.splitMethod == SplitMethod::BinnedSAH && howShouldICutBySAH(work, first, last, cuttingPosition, cost))
+	{
+		if (cost >= 1)
+		{
+			return leaf;
+		}
+	}
+	else if (work.partitionByCentroids)
+	{
+		if (!howShouldICutByCentroids(work, first, last, cuttingPosition))
+		{
+			return leaf;
+		}
+	}
+	else
+	{
+		cuttingPosition = Volume::split(parent, work, first, last);
+	}
+
+	//0 - left side, 1 - both sides, 2 - right side, 3 - neither side; the partitioned triangles are never on both sides
+	const int axis = std::get<0>(cuttingPosition);
+	const float position = std::get<1>(cuttingPosition);
+	const auto classify = [&](size_t begin, size_t end)
+	{
+		if (work.partitionByCentroids)
+		{
+			work.store.classifyCentroids(begin, end, axis, position, work.sides.data() + (begin - first));
 		}
+		else
+		{
+			work.store.classify(begin, end, axis, position, work.sides.data() + (begin - first));
+		}
+	};
+	if (work.pool != nullptr && last - first >= 2 * BVHBuildWork::PASS_GRAIN)
+	{
+		work.pool->parallelFor(first, last, BVHBuildWork::PASS_GRAIN, classify);
 	}
-	return std::make_tuple(leftSet, rightSet);
+	else
+	{
+		classify(first, last);
+	}
+
+	size_t counts[4] = {};
+	for (size_t i = 0; i < last - first; i++)
+	{
+		counts[work.sides[i]]++;
+	}
+	sortBySide(work, first, last);
+	return std::make_tuple(counts[0], counts[1], counts[2]);
 }
 
 /**
  * This method will construct a binary bounding volume hierarchy (BVH) tree from the set of triangles of the given depth.
  * The geometry that should be used to build the tree is defined by the volumeType parameter and can be either axis-aligned bounding box or sphere.
+ * The cutting planes are chosen by the splitMethod of the example: the midpoint of the longest axis, the binned surface area heuristic, or the SBVH,
+ * which also cuts the space and bounds only the parts of the crossing triangles on each side (see howShouldICutSpatially()).
+ * The triangles crossing a plane are referenced by both children, unless partitionByCentroids puts each triangle into the child of its centroid.
  * You will get 15 points if you implement this method for one of the volume types or 20 points if your implementation supports both.
  *
- * The method should return the root of the BVH tree.
- * Each node in the tree is represented by an instance of either AABB (axis-aligned bounding box) or BSV (bounding sphere volume) class.
- * Note that both AABB and BSV are inheriting from the BVH class.
- * Make sure that you are properly set up the children and parents for each node; otherwise, the skeleton will not be able to visualize the tree correctly.
+ * The method should return the BVH tree (or nullptr for the depth 0).
+ * The nodes of the tree are stored in a single array in the depth-first pre-order and each holds either an axis-aligned bounding box or a bounding sphere (see BVHNode).
+ * Make sure that you are properly set up the right child of each inner node; otherwise, the skeleton will not be able to visualize the tree correctly.
  * Also make sure you are assigning correct triangles that are inside the bounding volume represented by each node.
  *
- * @param triangles - The set of triangles.
- * @param depth - The maximum depth the binary tree should have.
+ * The nodes do not store the triangles; each leaf references a range of the triangle array of the tree
+ * and each inner node the range spanning its leaves (see BVH).
+ *
+ * @param triangles - The triangles.
+ * @param depth - The maximum depth the binary tree should have; the nodes with at most maxLeafTriangles triangles, the nodes whose cut leaves a child empty
+ *                or sends all triangles to one child, and the nodes the SAH finds cheaper as leaves become leaves sooner.
  * @param volumeType - The flag determining the requested bounding volume.
  */
-BVH* BVHExample::construct(const unordered_set<Triangle*> & triangles, int depth, VolumeType volumeType) const
+BVH* BVHExample::construct(const vector<Triangle*> & triangles, int depth, VolumeType volumeType) const
 {
-	if (depth == 0)
+	if (depth <= 0)
 	{
 		return nullptr;
 	}
 
-	if (volumeType == VolumeType::AxisAlignedBoundingBox)
+	// a full tree of the given depth, but no more nodes than two per triangle
+	const size_t nodeCount = std::min(BVH::fullTreeNodes(depth), std::max<size_t>(triangles.size(), 1) * 2);
+	// the triangles crossing the cuts are referenced by several leaves, so the arrays of the tree get some extra space for them
+	const size_t referenceCount = triangles.size() + triangles.size() / 4;
+	BVH* tree = new BVH(volumeType, BVH::arenaSize(nodeCount, referenceCount, useQuantizedVertices));
+	if (useQuantizedVertices)
 	{
+		// the queries dequantize the 16-bit vertices of the tree on the fly; the work arrays keep the floats the kernels of the construction need
+		tree->triangles.setQuantization(model->quantizedMesh.getOrigin(), model->quantizedMesh.getStep());
+	}
+	tree->nodes.reserve(nodeCount);
+	tree->references.reserve(referenceCount);
+	tree->triangles.reserve(referenceCount);
 
-		auto borders = findMinsAndMax(triangles);
-
-		AABB *box = new AABB(std::get<0>(borders), std::get<2>(borders), std::get<4>(borders),
-			std::get<1>(borders), std::get<3>(borders), std::get<5>(borders), triangles);
+	// the work arrays of the previous construction are discarded at once and their memory is reused
+	buildArena.reset();
+	BVHBuildWork work(&buildArena);
+	// the crossing triangles copied for the right children rarely double the work arrays; if they do, the arrays move to the heap
+	work.triangles.reserve(triangles.size() * 2);
+	work.store.reserve(triangles.size() * 2);
+	work.triangles.assign(triangles.begin(), triangles.end());
+	fillTriangleStore(TriangleRange(work.triangles.data(), work.triangles.data() + work.triangles.size()), work.store);
+	work.splitMethod = splitMethod;
+	work.binCount = binCount;
+	work.maxLeafTriangles = static_cast<size_t>(std::max(maxLeafTriangles, 0));
+	work.partitionByCentroids = partitionByCentroids;
+	work.pool = buildPool.threadCount() > 1 ? &buildPool : nullptr;
+	if (splitMethod == SplitMethod::Spatial && !triangles.empty())
+	{
+		//the spheres bound whole triangles, so their trees get only the partitions of the SBVH
+		work.boxes.reserve(triangles.size() * 2);
+		work.boxes.resize(triangles.size());
+		work.store.boxes(0, triangles.size(), work.boxes.data());
+		auto borders = findMinsAndMax(work.boxes.data(), work.boxes.data() + work.boxes.size());
+		work.rootArea = surfaceArea(TriangleBox{ { std::get<0>(borders), std::get<2>(borders), std::get<4>(borders) }, { std::get<1>(borders), std::get<3>(borders), std::get<5>(borders) } });
+		work.spatialBudget = volumeType == VolumeType::AxisAlignedBoundingBox ? static_cast<size_t>(triangles.size() * std::max(duplicationBudget, 0.f)) : 0;
+	}
+	work.reserveNodeArrays(triangles.size());
+	tree->triangles.setErrorBound(work.store.getErrorBound());
+	//the volume type is resolved here once; the recursion calls the functions of the volume policy directly
+	if (splitMethod == SplitMethod::Morton)
+	{
+		//the 30-bit codes have 1024 cells per axis, which the largest meshes crowd, so they get the 63-bit codes
+		const bool longCodes = triangles.size() > (static_cast<size_t>(1) << 20);
+		if (volumeType == VolumeType::AxisAlignedBoundingBox && longCodes)
+		{
+			constructLinear<BoxVolume, uint64_t>(work, depth, *tree);
+		}
+		else if (volumeType == VolumeType::AxisAlignedBoundingBox)
+		{
+			constructLinear<BoxVolume, uint32_t>(work, depth, *tree);
+		}
+		else if (longCodes)
+		{
+			constructLinear<SphereVolume, uint64_t>(work, depth, *tree);
+		}
+		else
+		{
+			constructLinear<SphereVolume, uint32_t>(work, depth, *tree);
+		}
+	}
+	else if (volumeType == VolumeType::AxisAlignedBoundingBox)
+	{
+		constructRange<BoxVolume>(work, 0, work.triangles.size(), depth, *tree);
+	}
+	else
+	{
+		constructRange<SphereVolume>(work, 0, work.triangles.size(), depth, *tree);
+	}
+	return tree;
+}
 
-		auto children = cutModel(*box);
+/**
+* @param codes - Morton codes sorted in ascending order
+* @param first - first code of the node
+* @param last - code after the last code of the node
+*
+* @return - first code of the right child: the codes of the node share their bits above the highest bit in which the first and the last code differ,
+*           so the codes with this bit zero form the left child; the node is halved if all its codes are equal
+**/
+template <typename Code>
+size_t findMortonSplit(const vector<Code>& codes, size_t first, size_t last)
+{
+	const Code difference = codes[first] ^ codes[last - 1];
+	if (difference == 0)
+	{
+		return (first + last) / 2;
+	}
+	int bit = MORTON_BITS<Code> - 1;
+	while (((difference >> bit) & 1) == 0)
+	{
+		bit--;
+	}
+	const Code mask = static_cast<Code>(1) << bit;
+	return std::partition_point(codes.begin() + first, codes.begin() + last, [mask](Code code) { return (code & mask) == 0; }) - codes.begin();
+}
 
-		auto leftChild = construct(std::get<0>(children), depth - 1, volumeType);
-		auto rightChild = construct(std::get<1>(children), depth - 1, volumeType);
-		
-		if (depth != 1)
+/**
+ * Constructs the linear BVH (LBVH) of the triangles of the work arrays: the triangles are sorted by the Morton codes of their centroids in the [-1,1] cube
+ * of the normalized model with the radix sort, and the nodes are emitted from the sorted codes (see emitLinear()).
+ * The time is linear in the number of triangles, and each triangle is referenced by exactly one leaf, but the cuts only follow the octree cells,
+ * so the trees are usually looser than those of the midpoint split or the SAH.
+ *
+ * @param work - The work arrays of triangles; they are sorted by the codes.
+ * @param depth - The maximum depth of the tree.
+ * @param tree - The empty tree the nodes and triangle references are appended to.
+ */
+template <class Volume, typename Code>
+void BVHExample::constructLinear(BVHBuildWork& work, int depth, BVH& tree) const
+{
+	const size_t count = work.triangles.size();
+	vector<Code> codes(count);
+	vector<uint32_t> order(count);
+	const auto encode = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
 		{
-			box->setLeft(leftChild);
-			box->setRight(rightChild);
-
-			leftChild->setParent(box);
-			rightChild->setParent(box);
+			codes[i] = mortonCode<Code>(work.store.centroid(i));
+			order[i] = static_cast<uint32_t>(i);
 		}
-		
-		return box;
+	};
+	if (work.pool != nullptr)
+	{
+		work.pool->parallelFor(0, count, BVHBuildWork::PASS_GRAIN, encode);
+	}
+	else
+	{
+		encode(0, count);
+	}
+	radixSort(codes, order, MORTON_BITS<Code>, work.pool);
+
+	//the triangles and their vertices are reordered by the codes, so the triangles of each node form a range
+	work.targets.resize(count);
+	work.reordered.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		work.targets[order[i]] = static_cast<uint32_t>(i);
+		work.reordered[i] = work.triangles[order[i]];
+	}
+	std::copy(work.reordered.begin(), work.reordered.end(), work.triangles.begin());
+	work.store.permute(0, count, work.targets.data());
+
+	emitLinear<Volume, Code>(work, codes, 0, count, depth, tree);
+}
+
+/**
+ * Appends the node of the given range of the sorted triangles and its subtrees to the tree and returns its index.
+ * The leaves compute their volumes from their triangles, and the inner nodes merge the volumes of their children (see BoxVolume::merge()),
+ * so each triangle is visited once regardless of the depth.
+ *
+ * @param work - The work arrays of triangles sorted by their codes.
+ * @param codes - The sorted Morton codes of the triangles.
+ * @param first - The first triangle of the node.
+ * @param last - The triangle after the last triangle of the node.
+ * @param depth - The maximum depth of the subtree.
+ * @param tree - The tree the nodes and triangle references are appended to.
+ */
+template <class Volume, typename Code>
+uint32_t BVHExample::emitLinear(BVHBuildWork& work, const vector<Code>& codes, size_t first, size_t last, int depth, BVH& tree) const
+{
+	const uint32_t index = tree.size();
+	tree.nodes.push_back(BVHNode());
+	const uint32_t begin = static_cast<uint32_t>(tree.references.size());
+
+	BVHNode node = {};
+	if (depth == 1 || last - first <= std::max<size_t>(work.maxLeafTriangles, 1))
+	{
+		Volume::bound(node, work, first, last);
+		tree.references.insert(tree.references.end(), work.triangles.begin() + first, work.triangles.begin() + last);
+		tree.triangles.resize(tree.references.size());
+		tree.triangles.copy(work.store, first, last - first, begin);
+		node.setLeaf(begin, static_cast<uint32_t>(last - first));
 	}
 	else
 	{
-		auto sphereTuple =computeSphere(triangles);
+		const size_t split = findMortonSplit(codes, first, last);
+		emitLinear<Volume, Code>(work, codes, first, split, depth - 1, tree);
+		const uint32_t right = emitLinear<Volume, Code>(work, codes, split, last, depth - 1, tree);
+		Volume::merge(node, tree.nodes[index + 1], tree.nodes[right]);
+		node.setInner(begin, right);
+	}
+	tree.nodes[index] = node;
+	return index;
+}
+
+/**
+ * Constructs the subtree from the triangles in the given range of the work array.
+ * The range is reordered in place; the triangles crossing the cut are copied to the end of the work arrays for the right child,
+ * so each level needs extra space only for them. The vertices of the work triangles are kept in blocks next to them (see TriangleSoA),
+ * so the bounds and the sides of the cut are computed for many triangles at once. The node is appended to the nodes of the tree before its subtrees,
+ * which keeps the nodes in the pre-order, and the leaves append their triangles and their vertices to the tree.
+ * The bounding volume and the cut are computed by the volume policy (BoxVolume or SphereVolume) of the tree.
+ * The node becomes a leaf at the maximum depth, if it has at most work.maxLeafTriangles triangles, or if its cut does not separate the triangles.
+ * If the builder has a task pool, the passes over the large nodes are split among its threads and the right subtrees of the large nodes
+ * are built by other threads into their own trees while this thread builds the left subtree; the trees are the same as the serial ones.
+ *
+ * @param work - The work arrays of triangles.
+ * @param first - The first triangle of the node in the work arrays.
+ * @param last - The triangle after the last triangle of the node in the work arrays.
+ * @param depth - The maximum depth of the subtree.
+ * @param tree - The tree the nodes and triangle references are appended to.
+ */
+template <class Volume>
+void BVHExample::constructRange(BVHBuildWork& work, size_t first, size_t last, int depth, BVH& tree) const
+{
+	const size_t count = last - first;
+	BVHNode node = {};
+	Volume::bound(node, work, first, last);
 
-		BSV* sphere = new BSV(std::get<0>(sphereTuple).x, std::get<0>(sphereTuple).y, std::get<0>(sphereTuple).z,
-			std::get<1>(sphereTuple) , triangles);
+	//the children are appended after the node, so it is referred to by its index;
+	//the duplicated triangles may outgrow the arrays estimated for the tree, which then move to the heap (see reserveGrowth())
+	const uint32_t index = tree.size();
+	reserveGrowth(tree.nodes, tree.nodes.size() + 1);
+	tree.nodes.push_back(node);
 
-		auto children = cutModel(*sphere);
+	const uint32_t begin = static_cast<uint32_t>(tree.references.size());
+	if (depth > 1 && count > work.maxLeafTriangles)
+	{
+		auto children = cutModel<Volume>(node, work, first, last);
+		const size_t leftCount = std::get<0>(children) + std::get<1>(children);
+		const size_t rightCount = std::get<1>(children) + std::get<2>(children);
+		const size_t rightFirst = work.triangles.size() - rightCount;
 
-		auto leftChild = construct(std::get<0>(children), depth - 1, volumeType);
-		auto rightChild = construct(std::get<1>(children), depth - 1, volumeType);
+		//the duplication budget left after the cut is shared by the children in proportion to their triangles (SBVH)
+		const size_t duplicates = leftCount + rightCount - count;
+		const size_t budget = work.spatialBudget > duplicates ? work.spatialBudget - duplicates : 0;
+		const size_t leftBudget = budget * leftCount / std::max<size_t>(leftCount + rightCount, 1);
 
-		if (depth != 1)
+		if (leftCount == 0 || rightCount == 0 || leftCount == count || rightCount == count)
 		{
-			sphere->setLeft(leftChild);
-			sphere->setRight(rightChild);
+			//a child with no triangles or with all of them would not bring the leaves any closer, so the node stays a leaf
+			work.truncate(rightFirst);
+		}
+		else if (work.pool != nullptr && depth > 2 && leftCount >= BVHBuildWork::TASK_THRESHOLD && rightCount >= BVHBuildWork::TASK_THRESHOLD)
+		{
+			//the right subtree is built by another thread into its own tree, which is appended after the left subtree
+			MemoryArena arena;
+			BVHBuildWork rightWork(&arena);
+			rightWork.splitMethod = work.splitMethod;
+			rightWork.binCount = work.binCount;
+			rightWork.maxLeafTriangles = work.maxLeafTriangles;
+			rightWork.partitionByCentroids = work.partitionByCentroids;
+			rightWork.spatialBudget = budget - leftBudget;
+			rightWork.rootArea = work.rootArea;
+			rightWork.pool = work.pool;
+			rightWork.triangles.reserve(rightCount * 2);
+			rightWork.store.reserve(rightCount * 2);
+			rightWork.triangles.assign(work.triangles.begin() + rightFirst, work.triangles.end());
+			rightWork.store.resize(rightCount);
+			rightWork.store.copy(work.store, rightFirst, rightCount, 0);
+			rightWork.store.setErrorBound(work.store.getErrorBound());
+			if (!work.boxes.empty())
+			{
+				rightWork.boxes.reserve(rightCount * 2);
+				rightWork.boxes.assign(work.boxes.begin() + rightFirst, work.boxes.end());
+			}
+			rightWork.reserveNodeArrays(rightCount);
+			work.truncate(rightFirst);
+			work.spatialBudget = leftBudget;
 
-			leftChild->setParent(sphere);
-			rightChild->setParent(sphere);
+			BVH rightTree(tree.volumeType, BVH::arenaSize(std::min(BVH::fullTreeNodes(depth - 1), rightCount * 2), rightCount + rightCount / 4, tree.triangles.isQuantized()));
+			if (tree.triangles.isQuantized())
+			{
+				rightTree.triangles.setQuantization(tree.triangles.getOrigin(), tree.triangles.getStep());
+			}
+			rightTree.triangles.setErrorBound(tree.triangles.getErrorBound());
+			TaskPool::Group group;
+			work.pool->run(group, [&]()
+			{
+				constructRange<Volume>(rightWork, 0, rightCount, depth - 1, rightTree);
+			});
+			constructRange<Volume>(work, first, first + leftCount, depth - 1, tree);
+			work.pool->wait(group);
+
+			const uint32_t right = tree.size();
+			tree.append(rightTree);
+			tree.nodes[index].setInner(begin, right);
+			return;
 		}
+		else
+		{
+			work.spatialBudget = leftBudget;
+			constructRange<Volume>(work, first, first + leftCount, depth - 1, tree);
+			const uint32_t right = tree.size();
+			work.spatialBudget = budget - leftBudget;
+			constructRange<Volume>(work, rightFirst, rightFirst + rightCount, depth - 1, tree);
+			work.truncate(rightFirst);
 
-		return sphere;
+			//inner nodes reference the range spanning their leaves, which ends with the rightmost leaf
+			tree.nodes[index].setInner(begin, right);
+			return;
+		}
+	}
+
+	//the triangles of the range may have been reordered by a cut that did not pay off, but they are still the same
+	reserveGrowth(tree.references, tree.references.size() + count);
+	tree.references.insert(tree.references.end(), work.triangles.begin() + first, work.triangles.begin() + last);
+	tree.triangles.resize(tree.references.size());
+	tree.triangles.copy(work.store, first, last - first, begin);
+	tree.nodes[index].setLeaf(begin, static_cast<uint32_t>(last - first));
+}
+
+/**
+ * Copies the vertices of the given triangles into the store; the dequantized vertices are used if the tree is built from the quantized vertices,
+ * and a quantized store (see TriangleSoA::setQuantization()) rounds them back to their 16-bit steps.
+ *
+ * @param triangles - The triangles.
+ * @param store - The store receiving the vertices in the order of the triangles.
+ */
+void BVHExample::fillTriangleStore(TriangleRange triangles, TriangleSoA& store) const
+{
+	store.resize(triangles.size());
+	buildPool.parallelFor(0, triangles.size(), BVHBuildWork::PASS_GRAIN, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			if (useQuantizedVertices)
+			{
+				const size_t index = model->mesh.indexOf(triangles[i]);
+				store.set(i, model->quantizedMesh.getVertex(index, 0), model->quantizedMesh.getVertex(index, 1), model->quantizedMesh.getVertex(index, 2));
+			}
+			else
+			{
+				store.set(i, triangles[i]->v1, triangles[i]->v2, triangles[i]->v3);
+			}
+		}
+	});
+	store.setErrorBound(useQuantizedVertices ? model->quantizedMesh.getErrorBound() : Tuple3f());
+}
+
+/**
+ * Refits the bounding volumes of the tree to the moved vertices of its triangles, e.g., to the next frame of an animated mesh; the nodes and the triangle references stay the same.
+ * The vertices are copied from the triangles into the vertex store of the tree, so the refitted tree holds the exact vertices even if it was built from the quantized ones.
+ * The volumes are computed from the leaves up (see refitLevels()), so a frame costs a small part of a construction, but they grow looser
+ * as the vertices move away from the positions the tree was built for, and the leaves of the SBVH bound their whole triangles instead of the clipped parts.
+ *
+ * @param tree - The tree of the moved triangles.
+ */
+void BVHExample::refit(BVH& tree) const
+{
+	//the moved vertices leave the grid of the quantized ones
+	tree.triangles.dequantize();
+	buildPool.parallelFor(0, tree.references.size(), BVHBuildWork::PASS_GRAIN, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const Triangle* triangle = tree.references[i];
+			tree.triangles.set(i, triangle->v1, triangle->v2, triangle->v3);
+		}
+	});
+	tree.triangles.setErrorBound(Tuple3f());
+
+	if (tree.volumeType == VolumeType::AxisAlignedBoundingBox)
+	{
+		refitLevels<BoxVolume>(tree);
+	}
+	else
+	{
+		refitLevels<SphereVolume>(tree);
+	}
+}
+
+/**
+ * Bounds the leaves of the tree again and sets the volume of each inner node to the union of the volumes of its children (see BoxVolume::merge()).
+ * The levels are processed from the deepest one, so the children of a node are refitted before it, and the nodes of each level are split among the threads of the builder.
+ *
+ * @param tree - The tree whose vertex store holds the moved vertices.
+ */
+template <class Volume>
+void BVHExample::refitLevels(BVH& tree) const
+{
+	const vector<vector<uint32_t>> levels = tree.getLevels();
+	for (size_t level = levels.size(); level-- > 0;)
+	{
+		const vector<uint32_t>& nodes = levels[level];
+		buildPool.parallelFor(0, nodes.size(), REFIT_GRAIN, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				BVHNode& node = tree.nodes[nodes[i]];
+				if (!node.isLeaf())
+				{
+					Volume::merge(node, tree.nodes[tree.getLeft(nodes[i])], tree.nodes[tree.getRight(nodes[i])]);
+				}
+				else if (node.getCount() > 0)
+				{
+					Volume::bound(node, tree);
+				}
+			}
+		});
 	}
 }
 
@@ -414,7 +1293,7 @@ bool isVertexVisible(const Tuple3f& vertex, const Tuple3f& cameraPosition, Vecto
  *		   0 if box is partialy visible
  *		   1 if box is visible
  **/
-int isBoxVisible(const AABB& box, const Tuple3f& cameraPosition, const Vector3f & cameraNormal)
+int isBoxVisible(const BVHNode& box, const Tuple3f& cameraPosition, const Vector3f & cameraNormal)
 {
 	Tuple3f max = box.getMax();
 	Tuple3f min = box.getMin();
@@ -461,7 +1340,7 @@ int isBoxVisible(const AABB& box, const Tuple3f& cameraPosition, const Vector3f
 	return ret;
 }
 
-int isSphereVisible(const BSV& sphere, const Tuple3f& cameraPosition, const Vector3f& cameraNormal) 
+int isSphereVisible(const BVHNode& sphere, const Tuple3f& cameraPosition, const Vector3f& cameraNormal) 
 {
 	int ret = -1;
 	if (isVertexVisible(sphere.getCenter(), cameraPosition, cameraNormal)) 
@@ -480,6 +1359,45 @@ int isSphereVisible(const BSV& sphere, const Tuple3f& cameraPosition, const Vect
 	return ret;
 }
 
+int BoxVolume::classify(const BVHNode& node, const Tuple3f& cameraPosition, const Vector3f& cameraNormal)
+{
+	return isBoxVisible(node, cameraPosition, cameraNormal);
+}
+
+int SphereVolume::classify(const BVHNode& node, const Tuple3f& cameraPosition, const Vector3f& cameraNormal)
+{
+	return isSphereVisible(node, cameraPosition, cameraNormal);
+}
+
+/**
+ * Tests the triangles of the given leaf and inserts the visible ones into the set.
+ * The vertices of the leaf are stored next to each other, so its triangles are tested in blocks (see TriangleSoA).
+ *
+ * @param tree - The tree.
+ * @param leaf - The leaf.
+ * @param cameraPosition - The position of the camera.
+ * @param cameraNormal - The normal of the camera plane.
+ * @param leafVisibility - The buffer receiving the visibility of the triangles.
+ * @param visible - The set the visible triangles are inserted into.
+ *
+ * @return The number of tested triangles.
+ */
+uint32_t testLeaf(const BVH& tree, uint32_t leaf, const Tuple3f& cameraPosition, const Vector3f& cameraNormal, vector<uint8_t>& leafVisibility, unordered_set<Triangle*>& visible)
+{
+	const BVHNode& volume = tree[leaf];
+	const uint32_t count = volume.getCount();
+	leafVisibility.resize(count);
+	tree.triangles.visible(volume.begin, volume.begin + count, cameraPosition, cameraNormal, 0.000001f, leafVisibility.data());
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (leafVisibility[i])
+		{
+			visible.insert(tree.references[volume.begin + i]);
+		}
+	}
+	return count;
+}
+
 /**
  * This method will return all possibly visible triangles from the current camera (assuming orthographic projection).
  * In other words, the method will return all triangles that have at least one vertex in a half-space defined by a plane.
@@ -491,74 +1409,161 @@ int isSphereVisible(const BSV& sphere, const Tuple3f& cameraPosition, const Vect
  * Additionally, you also have to return all the bounding boxes that are partially visible from the camera (via visible volumes parameter).
  *
  * The most basic solution would be to brute-force the solution by simply testing all the triangles. Nevertheless, the goal of this assignment is to use the BVH tree you have constructed in the previous method to avoid testing all of them. To check how much you are saving, the framework will calculate the theoretical number of triangles that should be tested based on the visible volumes you returned. If you want to compare your own implementation with this value, you can also return the actual number of triangles you have tested in your algorithm via testedTriangles parameter.
- * Note that the PVS method only accepts the generic BVH instance on the input.
- * Hence you will have to determine the type of the node yourself in the code.
- * This can be done using dynamic_cast in C++ or instanceof in Java (see the code in the skeleton for more details).
+ * Note that all nodes of a tree use the same bounding volume, so the type is determined once from tree.volumeType
+ * and the traversal is instantiated for its volume policy (see traverse()).
+ * The nodes are traversed in the node array of the tree; the children of a partially visible node are pushed to a stack, the left one last,
+ * so the nodes are mostly read in the order in which they are stored.
  *
  * Again, you will get 15 points if you implement this method for one of the volume types or 20 points if your implementation supports both.
  *
  *
- * @param node - The root of the tree.
+ * @param tree - The tree.
+ * @param node - The node to start from (BVH::ROOT for the whole tree).
  * @param cameraPosition - The position of the camera.
  * @param cameraNormal - The normal of the camera plane, i.e., the direction in which the camera is pointing.
  * @param cameraRightVector - Defines the vector point to the right side of the camera. It is placesOne of the two vectors in the camera plane - it is orthogonal to cameraUpVector.
  * @param cameraUpVector - Second of the two vectors in the camera plane - it is orthogonal to cameraRightVector.
  * @param testedTriangles - At the end of the method this variable should contain the number of actually tested triangles.
+ * @param visitedNodes - At the end of the method this variable contains the number of nodes whose volumes were tested.
  * @param visibleVolumes - At the end of the method this set should contain all volumes that the camera sees.
  *
  * @return The method will return all triangles that are visible from the camera
  */
-unordered_set<Triangle*> BVHExample::pvs(BVH* node, const Tuple3f cameraPosition, const Vector3f cameraNormal, 
+unordered_set<Triangle*> BVHExample::pvs(const BVH& tree, uint32_t node, const Tuple3f cameraPosition, const Vector3f cameraNormal, 
 	const Vector3f cameraRightVector, const Vector3f cameraUpVector, 
-	int& testedTriangles, unordered_set<BVH*>& visibleVolumes) const
+	int& testedTriangles, int& visitedNodes, unordered_set<uint32_t>& visibleVolumes) const
 {
-	int visibilityCheck = -1;
-	if (AABB* aabb = dynamic_cast<AABB*>(node))
-	{
-		visibilityCheck = isBoxVisible(*aabb, cameraPosition, cameraNormal);
-	}
-	else if (BSV* sbb = dynamic_cast<BSV*>(node))
+	if (tree.volumeType == VolumeType::AxisAlignedBoundingBox)
 	{
-		visibilityCheck = isSphereVisible(*sbb, cameraPosition, cameraNormal);
+		return traverse<BoxVolume>(tree, node, cameraPosition, cameraNormal, testedTriangles, visitedNodes, visibleVolumes);
 	}
-	unordered_set<Triangle*> visible;
+	return traverse<SphereVolume>(tree, node, cameraPosition, cameraNormal, testedTriangles, visitedNodes, visibleVolumes);
+}
 
-	switch (visibilityCheck)
+/**
+ * Returns the triangles of the binary tree visible from the camera (see pvs()); the nodes are classified by the given volume policy.
+ *
+ * @param tree - The tree.
+ * @param node - The node to start from.
+ * @param cameraPosition - The position of the camera.
+ * @param cameraNormal - The normal of the camera plane.
+ * @param testedTriangles - At the end of the method this variable contains the number of actually tested triangles.
+ * @param visitedNodes - At the end of the method this variable contains the number of nodes whose volumes were tested.
+ * @param visibleVolumes - At the end of the method this set contains all volumes that the camera sees.
+ */
+template <class Volume>
+unordered_set<Triangle*> BVHExample::traverse(const BVH& tree, uint32_t node, const Tuple3f& cameraPosition, const Vector3f& cameraNormal,
+	int& testedTriangles, int& visitedNodes, unordered_set<uint32_t>& visibleVolumes) const
+{
+	unordered_set<Triangle*> visible;
+	vector<uint8_t> leafVisibility;
+	vector<uint32_t> stack(1, node);
+	while (!stack.empty())
 	{
-	case(-1):
-		return unordered_set<Triangle*>();
-		break;
-	case(0):
-		visibleVolumes.insert(node);
-		if (node->isLeaf())
+		const uint32_t index = stack.back();
+		stack.pop_back();
+		const BVHNode& volume = tree[index];
+		visitedNodes++;
+
+		switch (Volume::classify(volume, cameraPosition, cameraNormal))
 		{
-			for (auto triangle : node->getTriangles())
+		case(-1):
+			break;
+		case(0):
+			visibleVolumes.insert(index);
+			if (volume.isLeaf())
 			{
-				testedTriangles++;
-				if (isVertexVisible(triangle->v1, cameraPosition, cameraNormal) ||
-					isVertexVisible(triangle->v2, cameraPosition, cameraNormal) ||
-					isVertexVisible(triangle->v3, cameraPosition, cameraNormal))
-				{
-					visible.insert(triangle);
-				}
+				testedTriangles += testLeaf(tree, index, cameraPosition, cameraNormal, leafVisibility, visible);
 			}
-		}
-		else
+			else
+			{
+				stack.push_back(tree.getRight(index));
+				stack.push_back(tree.getLeft(index));
+			}
+			break;
+		case(1):
 		{
-			auto leftVisible = pvs(node->getLeft(), cameraPosition, cameraNormal, cameraRightVector, cameraUpVector, testedTriangles, visibleVolumes);
-			visible.insert(leftVisible.begin(), leftVisible.end());
-			auto rightVisible = pvs(node->getRight(), cameraPosition, cameraNormal, cameraRightVector, cameraUpVector, testedTriangles, visibleVolumes);
-			visible.insert(rightVisible.begin(), rightVisible.end());
+			visibleVolumes.insert(index);
+			const TriangleRange triangles = tree.getTriangles(index);
+			visible.insert(triangles.begin(), triangles.end());
+			break;
 		}
-		return visible;
-		break;
-	case(1):
-		visibleVolumes.insert(node);
-		return node->getTriangles();
-		break;
-	default:
-		break;
+		default:
+			break;
+		}
+	}
+	return visible;
+}
+
+/**
+ * Returns the same triangles as the pvs() of the binary tree the wide tree was collapsed from, but it classifies all children of a node at once (see WideBVH::classify).
+ * The visible volumes are the nodes of the binary tree; the binary nodes collapsed into the wide nodes are never tested, so they are not reported.
+ *
+ * @param tree - The wide tree.
+ * @param cameraPosition - The position of the camera.
+ * @param cameraNormal - The normal of the camera plane, i.e., the direction in which the camera is pointing.
+ * @param testedTriangles - At the end of the method this variable contains the number of actually tested triangles.
+ * @param visitedNodes - At the end of the method this variable contains the number of visited wide nodes.
+ * @param visibleVolumes - At the end of the method this set contains all (binary) volumes that the camera sees.
+ *
+ * @return The method will return all triangles that are visible from the camera
+ */
+template <int WIDTH>
+unordered_set<Triangle*> BVHExample::pvs(const WideBVH<WIDTH>& tree, const Tuple3f cameraPosition, const Vector3f cameraNormal,
+	int& testedTriangles, int& visitedNodes, unordered_set<uint32_t>& visibleVolumes) const
+{
+	if (tree.source.volumeType == VolumeType::AxisAlignedBoundingBox)
+	{
+		return traverse<BoxVolume>(tree, cameraPosition, cameraNormal, testedTriangles, visitedNodes, visibleVolumes);
 	}
+	return traverse<SphereVolume>(tree, cameraPosition, cameraNormal, testedTriangles, visitedNodes, visibleVolumes);
+}
+
+/** Returns the triangles of the wide tree visible from the camera (see pvs()); the children are classified by the given volume policy. */
+template <class Volume, int WIDTH>
+unordered_set<Triangle*> BVHExample::traverse(const WideBVH<WIDTH>& tree, const Tuple3f& cameraPosition, const Vector3f& cameraNormal,
+	int& testedTriangles, int& visitedNodes, unordered_set<uint32_t>& visibleVolumes) const
+{
+	unordered_set<Triangle*> visible;
+	vector<uint8_t> leafVisibility;
+	vector<uint32_t> stack(1, WideBVH<WIDTH>::ROOT);
+	int classes[WIDTH];
+	while (!stack.empty())
+	{
+		const uint32_t index = stack.back();
+		stack.pop_back();
+		const WideBVHNode<WIDTH>& node = tree[index];
+		visitedNodes++;
+		tree.template classify<Volume>(index, cameraPosition, cameraNormal, classes);
 
-	return node->getTriangles();
+		//the children are pushed in the reverse order, so the leftmost child is processed first
+		for (int lane = static_cast<int>(node.count) - 1; lane >= 0; lane--)
+		{
+			if (classes[lane] < 0)
+			{
+				continue;
+			}
+			const uint32_t binary = node.binary[lane];
+			visibleVolumes.insert(binary);
+			if (classes[lane] > 0)
+			{
+				const TriangleRange triangles = tree.source.getTriangles(binary);
+				visible.insert(triangles.begin(), triangles.end());
+			}
+			else if (node.child[lane] == BVH_NO_NODE)
+			{
+				testedTriangles += testLeaf(tree.source, binary, cameraPosition, cameraNormal, leafVisibility, visible);
+			}
+			else
+			{
+				stack.push_back(node.child[lane]);
+			}
+		}
+	}
+	return visible;
 }
+
+template unordered_set<Triangle*> BVHExample::pvs<4>(const WideBVH<4>& tree, const Tuple3f cameraPosition, const Vector3f cameraNormal,
+	int& testedTriangles, int& visitedNodes, unordered_set<uint32_t>& visibleVolumes) const;
+template unordered_set<Triangle*> BVHExample::pvs<8>(const WideBVH<8>& tree, const Tuple3f cameraPosition, const Vector3f cameraNormal,
+	int& testedTriangles, int& visitedNodes, unordered_set<uint32_t>& visibleVolumes) const;
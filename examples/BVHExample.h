@@ -1,416 +1,716 @@
 ﻿#pragma once
 #include "../core/BaseWindow.h"
+#include <algorithm>
 #include <tuple>
 #include <cmath>
 #include <random>
 #include <sstream>
 #include <fstream>
+#include <iomanip>
 #include "../core/Image.h"
 #include "../vecmath/Triangle.h"
+#include "../vecmath/IndexedMesh.h"
+#include "../vecmath/QuantizedMesh.h"
 #include "../vecmath/Vector3f.h"
+#include "../vecmath/Vec4.h"
+#include "../vecmath/Morton.h"
+#include "../core/ModelLoader.h"
+#include "../core/RadixSort.h"
+#include "../core/TaskPool.h"
+#include "BVH.h"
+#include "WideBVH.h"
+#include "BVHVolume.h"
+#include "BVHCache.h"
+#include "BVHImage.h"
+#include "SceneManager.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
 #include <unordered_set>
 
-/**
- * The base class defining the shared functionality for all bounding volume hierarchy (BVH) trees.
- * The tree is binary and each instance of BVH class represents a single node in the tree.
- */
-class BVH
+/** The methods choosing the plane that cuts a node of the tree being built. */
+enum SplitMethod
 {
+	/** The plane halving the longest axis of the node (see howShouldICut()). */
+	Midpoint,
+	/** The plane between the bins of the centroids with the lowest surface area heuristic (see howShouldICutBySAH()). */
+	BinnedSAH,
+	/** The linear BVH: the triangles are sorted by the Morton codes of their centroids and cut at the first differing bit (see BVHExample::constructLinear()). */
+	Morton,
+	/** The SBVH: the binned SAH choosing between the partitions of the triangles and the spatial splits clipping the crossing triangles (see howShouldICutSpatially()). */
+	Spatial
+};
 
-public:
-
-	/** The set of triangles in the node. */
-	unordered_set<Triangle*> triangles;
-	/** The point to the parent node (if any). */
-	BVH* parent = nullptr;
-	/** The point to the left node (if any). */
-	BVH* left = nullptr;
-	/** The point to the right node (if any). */
-	BVH* right = nullptr;
+/** The average work of a pvs() query (see BVHExample::measureQueries()). */
+struct BVHQueryStats
+{
+	/** The number of nodes whose volumes were tested. */
+	double visitedNodes = 0;
+	/** The number of triangles tested one by one. */
+	double testedTriangles = 0;
+	/** The number of potentially visible triangles. */
+	double visibleTriangles = 0;
+	/** The time of the query in milliseconds. */
+	double milliseconds = 0;
+};
 
-	
+/** The refits of a tree to a deforming mesh compared with the rebuilds (see BVHExample::measureRefit()). */
+struct BVHRefitStats
+{
+	/** The average time of a refit in milliseconds. */
+	double refitMilliseconds = 0;
+	/** The time of the construction of the tree in milliseconds. */
+	double rebuildMilliseconds = 0;
+	/** The queries of the tree refitted to the last frame. */
+	BVHQueryStats refitted;
+	/** The queries of the tree rebuilt for the last frame. */
+	BVHQueryStats rebuilt;
+};
 
-	/** Constructs a new node in the tree encapsulating the given set of triangle. */
-	BVH(unordered_set<Triangle*> triangles) : triangles(triangles)
+/** The triangles a BVH tree is being constructed from (see BVHExample::constructRange). */
+struct BVHBuildWork
+{
+	/** The triangles; each node reorders its range in place and the right child gets a copy at the end. */
+	ArenaVector<Triangle*> triangles;
+	/** The vertices of the triangles in the same order. */
+	TriangleSoA store;
+	/** The side of the cut of each triangle of the node being cut, relative to its first triangle. */
+	ArenaVector<uint8_t> sides;
+	/** The new position of each triangle of the node being cut, relative to its first triangle. */
+	ArenaVector<uint32_t> targets;
+	/** The reordered triangles of the node being cut. */
+	ArenaVector<Triangle*> reordered;
+	/** The method choosing the cutting planes. */
+	SplitMethod splitMethod = SplitMethod::Midpoint;
+	/** The number of bins per axis of the binned SAH. */
+	int binCount = 16;
+	/** The number of triangles up to which a node becomes a leaf before the maximum depth is reached (0 - only the depth ends the recursion). */
+	size_t maxLeafTriangles = 0;
+	/** If true each triangle goes to the child its centroid lies in and the volumes of the children overlap; otherwise the crossing triangles go to both children. */
+	bool partitionByCentroids = false;
+	/** The bins of the node being cut (binned SAH). */
+	ArenaVector<TriangleBin> bins;
+	/** The cost of the plane after each bin of the node being cut (binned SAH). */
+	ArenaVector<float> binCosts;
+	/** The number of triangles ending in each bin of the node being cut (the spatial splits; the bins count the triangles starting in them). */
+	ArenaVector<uint32_t> binExits;
+	/** The boxes of the parts of the triangles inside their nodes, in the same order as the triangles (SBVH only, empty otherwise). */
+	ArenaVector<TriangleBox> boxes;
+	/** The boxes of the parts above the plane of the triangles crossing the spatial split of the node being cut, relative to its first triangle. */
+	ArenaVector<TriangleBox> splitBoxes;
+	/** The reordered boxes of the node being cut. */
+	ArenaVector<TriangleBox> reorderedBoxes;
+	/** The number of references the spatial splits of the subtree being built may still add. */
+	size_t spatialBudget = 0;
+	/** The surface area of the box of the root; the spatial splits are tried only for the nodes whose children overlap by a noticeable part of it. */
+	float rootArea = 0;
+	/** The threads building the large subtrees and splitting the passes over the large nodes (nullptr for the serial construction). */
+	TaskPool* pool = nullptr;
+
+	/** The smallest number of triangles on both sides of a cut for which the right subtree is built by another thread. */
+	static const size_t TASK_THRESHOLD = 4096;
+	/** The number of triangles processed by a single thread in the parallel passes over a node (a multiple of TriangleSoA::LANES). */
+	static const size_t PASS_GRAIN = 16384;
+	/** The cost of testing the volume of a node relative to the cost of testing a triangle; the SAH keeps a node as a leaf if its children would cost more. */
+	static constexpr float NODE_COST = 1.f;
+	/** The overlap of the children of the best partition (relative to the surface of the root) above which the spatial splits are tried. */
+	static constexpr float SPATIAL_OVERLAP = 1e-5f;
+
+	/** Constructs empty work arrays taking their memory from the given arena. */
+	BVHBuildWork(MemoryArena* arena) : triangles(arena), store(arena), sides(arena), targets(arena), reordered(arena), bins(arena), binCosts(arena),
+		binExits(arena), boxes(arena), splitBoxes(arena), reorderedBoxes(arena)
 	{
 	}
 
-	/** Renders the node with a given color. The implementation is left to the child classes. */
-	virtual void render(Color color, GLfloat matrix[4][4]) = 0;
-
-	/** Returns the depth of the node in the whole tree. */
-	int getDepth() const
+	/**
+	* Sizes the arrays of the node being cut for the given number of triangles, those of the root of the subtree, which no node below it exceeds;
+	* the arrays are thus taken from the arena once per build and never grow in it. The boxes have to be set before (SBVH).
+	*/
+	void reserveNodeArrays(size_t count)
 	{
-		int depth = 0;
-		const BVH* current = this;
-		while (current->getParent() != nullptr)
+		sides.resize(count);
+		targets.reserve(count);
+		reordered.reserve(count);
+		if (!boxes.empty())
 		{
-			depth++;
-			current = current->getParent();
+			splitBoxes.reserve(count);
+			reorderedBoxes.reserve(count);
 		}
-		return depth;
 	}
 
-	/** Returns the triangles stored in the node. */
-	unordered_set<Triangle*>& getTriangles()
+	/** Drops the triangles (and their boxes) after the given number, e.g., the copies for a right child that has been built. */
+	void truncate(size_t count)
 	{
-		return triangles;
+		triangles.resize(count);
+		store.resize(count);
+		if (!boxes.empty())
+		{
+			boxes.resize(count);
+		}
 	}
+};
 
-	/** Returns the parent node. */
-	BVH* getParent() const
-	{
-		return parent;
-	}
+/**
+ * The example for experimenting with BVH.
+ * Code for handling interactions and rendering of the window is in this header.
+ * The *.cpp file is designated for the implementation of the actual algorithms by students.
+ *
+ * @author	<a href="mailto:jan.byska@gmail.com">Jan Byška</a>
+ */
+class BVHExample : public BaseWindow
+{
 
-	/** Sets a new parent node. */
-	void setParent(BVH* parent)
-	{
-		this->parent = parent;
-	}
+private:
+
+	/** The models loaded so far, each with its triangles and tree. */
+	SceneManager scene;
+	/** The displayed model (nullptr until the worker loads it). */
+	SceneModel* model = nullptr;
+	/** The path to the model file (*.raw, *.stl, *.ply, *.obj, or *.bmesh) that is displayed first. */
+	static const string PATH;
+	/** The path to the displayed model file; 'm' switches to the next file in SceneManager::DIRECTORY. */
+	string modelPath = PATH;
+	/** The flag determining whether to use AxisAlignedBoundBox or Spheres for building the BVH tree. */
+	VolumeType volumeType = VolumeType::AxisAlignedBoundingBox;
+
+	/** The set of volumes (node indices) that were tested during the tracing of the BVH tree. */
+	unordered_set<uint32_t> visibleVolumes;
+	/** The set of visible triangles that were. */
+	unordered_set<Triangle*> visibleTriangles;
+	/** The set of triangles of the currently selected node (the nodes only reference ranges, which cannot be searched). */
+	unordered_set<Triangle*> currentTriangles;
+	/** The node the set of current triangles was collected for. */
+	uint32_t currentTrianglesNode = BVH_NO_NODE;
+	/** The number of triangles in visible bounding boxes (at the lowest level). */
+	int trianglesInVolumes = 0;
+	/** The actual number of triangles student returned. */
+	int testedTriangles = 0;
+	/** The number of nodes whose volumes were tested by pvs(). */
+	int visitedNodes = 0;
+
+	/** The displayed BVH tree. */
+	BVH* root = nullptr;
+	/** True if the displayed tree is a coarse tree owned by the example; the final tree is owned by the model. */
+	bool ownsRoot = true;
+	/** The number of children of the nodes traversed by pvs() (2, 4, or 8); 'n' switches between them. */
+	int branchingFactor = 2;
+	/** The displayed tree collapsed into a BVH4 (nullptr unless the branching factor is 4); it is owned by the example. */
+	WideBVH<4>* wideRoot4 = nullptr;
+	/** The displayed tree collapsed into a BVH8 (nullptr unless the branching factor is 8); it is owned by the example. */
+	WideBVH<8>* wideRoot8 = nullptr;
+	/** The memory of the displayed tree; it is collected once per tree, since counting the distinct triangles sorts the references. */
+	BVHFootprint rootFootprint;
+	/** The currently selected node in the BVH tree. */
+	uint32_t current = BVH::ROOT;
+	/** The parent of each node of the displayed tree (the nodes only know their children). */
+	vector<uint32_t> parents;
+	/** The currently displayed level of the hierarchy */
+	int displayLevel = 0;
+	/** The maximum depth of the tree; the nodes usually become leaves sooner (see maxLeafTriangles). */
+	int maxDepth = 32;
+	/** The number of triangles up to which a node becomes a leaf, so the leaves of large and small models hold similar numbers of triangles. */
+	int maxLeafTriangles = 8;
+	/** If true each triangle is referenced by a single leaf (see BVHBuildWork::partitionByCentroids); 'p' toggles it. */
+	bool partitionByCentroids = false;
+	/** The number of references the spatial splits of the SBVH may add, relative to the number of triangles. */
+	float duplicationBudget = 0.25f;
+	/** If true the constructed trees are stored in (and loaded from) the on-disk cache. */
+	bool useCache = true;
+	/** If true the tree is built and queried using the quantized vertices. */
+	bool useQuantizedVertices = false;
+	/** The method choosing the cutting planes of the nodes; 'h' switches between them. */
+	SplitMethod splitMethod = SplitMethod::Midpoint;
+	/** The number of bins per axis of the binned SAH. */
+	int binCount = 16;
+	/** The memory of the work arrays of the builder (used only by the worker); every construction resets it, so a rebuild reuses its chunks. */
+	mutable MemoryArena buildArena;
+	/** The threads of the builder (see TaskPool::defaultThreads); the worker waits for them, so they only run during a construction. */
+	mutable TaskPool buildPool;
+	/** The background thread loading the geometry and constructing the tree. */
+	thread worker;
+	/** Guards the tree published by the worker and the loading status. */
+	mutex workerMutex;
+	/** The most recent tree finished by the worker that has not been displayed yet. */
+	BVH* pendingRoot = nullptr;
+	/** The depth the pending tree was built with. */
+	int pendingDepth = 0;
+	/** True if the pending tree is the final tree of the model, which the model takes over; a preview is owned by the example. */
+	bool pendingFinal = false;
+	/** The cache key of the pending tree. */
+	BVHCacheKey pendingKey;
+	/** The depth the displayed tree was built with. */
+	int rootDepth = 0;
+	/** The description of the current step of the worker. */
+	string loadingStatus;
+	/** The finished part of the work of the worker (0-1). */
+	float loadingProgress = 0;
+	/** True while the worker is running. */
+	atomic<bool> loading{ false };
+	/** Set to ask the worker to stop after its current step. */
+	atomic<bool> cancelLoading{ false };
+	/** True if a redisplay is scheduled to pick up the progress of the worker. */
+	inline static bool refreshScheduled = false;
+	/** The interval in milliseconds in which the window is redrawn while the worker is running. */
+	static const int REFRESH_INTERVAL = 50;
 
-	/** Returns the left node. */
-	BVH* getLeft() const
+	/** If true the visible triangles will be highlighted. */
+	bool highlightVisible = true;
+	/** The flag determining if the visible triangles needs to be recomputed. */
+	bool dirty = true;
+
+	/** The current camera position. */
+	Tuple3f cameraPosition = Vector3f(0, 0, 0);
+	/** The current left vector of the camera. */
+	Vector3f cameraX = Vector3f(1, 0, 0);
+	/** The current up vector of the camera. */
+	Vector3f cameraY = Vector3f(0, 1, 0);
+	/** The current direction vector of the camera. */
+	Vector3f cameraZ = Vector3f(0, 0, 1);
+public:
+
+	/** Creates the new example window and starts loading the geometry in the background. */
+	BVHExample()
 	{
-		return left;
+		init();
 	}
 
-	/** Sets a new left node. This method also automatically sets parent node in the specified node to this. */
-	void setLeft(BVH* left)
+	/** Releases allocated memory on example destruction. */
+	~BVHExample()
 	{
-		this->left = left;
-		if (left != nullptr)
-			left->setParent(this);
+		stopWorker();
+		{
+			lock_guard<mutex> lock(workerMutex);
+			discardPendingTree();
+		}
+		releaseRoot();
 	}
 
-	/** Returns the right node. */
-	BVH* getRight() const
+	/** Rebuilds the tree using the given type of bounding volumes. */
+	void setVolumeType(VolumeType type)
 	{
-		return right;
+		stopWorker();
+		volumeType = type;
+		init();
 	}
 
-	/** Sets a new right node. This method also automatically sets parent node in the specified node to this. */
-	void setRight(BVH* right)
+	/** Rebuilds the tree with the given method choosing the cutting planes and the given number of bins per axis (used only by the binned SAH). */
+	void setSplitMethod(SplitMethod method, int bins = 16)
 	{
-		this->right = right;
-		if (right != nullptr)
-			right->setParent(this);
+		stopWorker();
+		splitMethod = method;
+		binCount = bins;
+		init();
 	}
 
-	/** Checks if the node is a leaf. */
-	bool isLeaf()
+	/** Rebuilds the tree with the triangles partitioned by their centroids (true) or with the crossing triangles in both children (false). */
+	void setPartitionByCentroids(bool partition)
 	{
-		return this->right == nullptr && this->left == nullptr;
+		stopWorker();
+		partitionByCentroids = partition;
+		init();
 	}
-};
-
-/** The axis aligned bounding box implementation of the BVH node. */
-class AABB : public BVH
-{
-
-private:
-
-	/** The point on the bounding box with minimum values in all axes (x,y,z). */
-	Tuple3f min;
-	/** The point on the bounding box with maximum values in all axes (x,y,z). */
-	Tuple3f max;
 
-public:
-
-	/** Constructs a new AABB node from the specified values. */
-	AABB(float minX, float minY, float minZ, float maxX, float maxY, float maxZ, unordered_set<Triangle*> triangles) : AABB(Tuple3f(minX, minY, minZ), Tuple3f(maxX, maxY, maxZ), triangles)
+	/** Rebuilds the tree with the given maximum depth. */
+	void setDepth(int depth)
 	{
+		stopWorker();
+		maxDepth = depth;
+		init();
 	}
 
-	/** Constructs a new AABB node from the specified values. */
-	AABB(Tuple3f min, Tuple3f max, unordered_set<Triangle*> triangles) : min(min), max(max), BVH(triangles)
+	/** Loads the given model file and builds its tree. */
+	void setModel(const string& path)
 	{
+		stopWorker();
+		modelPath = path;
+		init();
 	}
 
-	/** Returns the minimum point on the bounding box. */
-	Tuple3f getMin() const
+	/** Waits until the worker finishes and displays its final tree. */
+	void waitForTree()
 	{
-		return min;
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+		adoptPendingTree();
 	}
 
-	/** Returns the maximum point on the bounding box. */
-	Tuple3f getMax() const
+	/** Writes the final tree together with the mesh into a memory-mappable image (see BVHImage). */
+	bool exportImage(const string& path)
 	{
-		return max;
+		waitForTree();
+		return model != nullptr && BVHImage::write(path, root, model->mesh);
 	}
 
-	/** Sets a new minimum node for this node. */
-	void setMin(const Tuple3f min)
+	/**
+	* Measures the pvs() queries of the final tree with the camera plane through the center of the model turned in the given number of directions
+	* spread evenly over the sphere. Returns the averages of a single query.
+	*/
+	BVHQueryStats measureQueries(int directions)
 	{
-		this->min = min;
+		waitForTree();
+		return root != nullptr ? measureQueries(*root, directions) : BVHQueryStats();
 	}
 
-	/** Sets a new maximum point for this node. */
-	void setMax(const Tuple3f max)
+	/**
+	* Deforms the model by a wave moving its vertices along the y axis in the given number of frames and refits a tree built for the undeformed model
+	* after each frame (see refit()). The tree refitted to the last frame is compared with the tree rebuilt for it; the vertices are restored at the end.
+	* The trees are built from the exact vertices, since the quantized ones do not follow the deformation.
+	*
+	* @param frames		The number of frames.
+	* @param amplitude	The largest move of a vertex (the models are normalized to the [-1,1] cube).
+	* @param directions	The number of the queries compared (see measureQueries()).
+	*/
+	BVHRefitStats measureRefit(int frames, float amplitude, int directions)
 	{
-		this->max = max;
+		waitForTree();
+		BVHRefitStats stats;
+		if (model == nullptr || model->geometry.empty() || frames <= 0)
+		{
+			return stats;
+		}
+
+		const bool quantized = useQuantizedVertices;
+		useQuantizedVertices = false;
+		BVH* tree = construct(model->geometry, maxDepth, volumeType);
+		const vector<Tuple3f> rest = model->mesh.vertices;
+		for (int frame = 1; frame <= frames; frame++)
+		{
+			const float phase = frame * 0.3f;
+			for (size_t i = 0; i < rest.size(); i++)
+			{
+				model->mesh.vertices[i] = Tuple3f(rest[i].x, rest[i].y + amplitude * std::sin(4 * rest[i].x + phase), rest[i].z);
+			}
+			const auto start = chrono::steady_clock::now();
+			refit(*tree);
+			stats.refitMilliseconds += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		}
+		stats.refitMilliseconds /= frames;
+
+		const auto start = chrono::steady_clock::now();
+		BVH* rebuilt = construct(model->geometry, maxDepth, volumeType);
+		stats.rebuildMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		stats.refitted = measureQueries(*tree, directions);
+		stats.rebuilt = measureQueries(*rebuilt, directions);
+
+		delete tree;
+		delete rebuilt;
+		model->mesh.vertices = rest;
+		useQuantizedVertices = quantized;
+		return stats;
 	}
 
-	/** Renders the node with a specified color. */
-	void render(Color color, GLfloat matrix[4][4]) {
-		glColor3f(color.r, color.g, color.b);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		glBegin(GL_QUADS);
-		//FRONT
-		glVertex3f(min.x, min.y, max.z);
-		glVertex3f(max.x, min.y, max.z);
-		glVertex3f(max.x, max.y, max.z);
-		glVertex3f(min.x, max.y, max.z);
-		// BACK
-		glVertex3f(min.x, min.y, min.z);
-		glVertex3f(max.x, min.y, min.z);
-		glVertex3f(max.x, max.y, min.z);
-		glVertex3f(min.x, max.y, min.z);
-		// TOP
-		glVertex3f(min.x, min.y, min.z);
-		glVertex3f(min.x, min.y, max.z);
-		glVertex3f(max.x, min.y, max.z);
-		glVertex3f(max.x, min.y, min.z);
-		// BOTTOM
-		glVertex3f(min.x, max.y, min.z);
-		glVertex3f(min.x, max.y, max.z);
-		glVertex3f(max.x, max.y, max.z);
-		glVertex3f(max.x, max.y, min.z);
-		// LEFT
-		glVertex3f(min.x, min.y, min.z);
-		glVertex3f(min.x, max.y, min.z);
-		glVertex3f(min.x, max.y, max.z);
-		glVertex3f(min.x, min.y, max.z);
-		// RIGHT
-		glVertex3f(max.x, min.y, min.z);
-		glVertex3f(max.x, max.y, min.z);
-		glVertex3f(max.x, max.y, max.z);
-		glVertex3f(max.x, min.y, max.z);
-		glEnd();
+	/**
+	* Writes the memory of the final tree as a single line of JSON (see BVHFootprint), e.g., to track the memory of the trees between versions.
+	* Returns false if there is no tree or if its arena used more bytes than it was sized for.
+	*/
+	bool writeFootprint(ostream& out)
+	{
+		waitForTree();
+		if (model == nullptr || root == nullptr)
+		{
+			cout << "WARNING: the tree of " << (model != nullptr ? model->path : modelPath) << " could not be built." << endl;
+			return false;
+		}
+		// the backslashes of the Windows paths and the quotes have to be escaped in JSON
+		string path;
+		for (char c : model->path)
+		{
+			if (c == '\\' || c == '"')
+			{
+				path += '\\';
+			}
+			path += c;
+		}
+		out << "{\"model\": \"" << path << "\", \"triangles\": " << model->geometry.size() << ", \"depth\": " << rootDepth
+			<< ", \"quantized\": " << (useQuantizedVertices ? "true" : "false") << ", ";
+		rootFootprint.write(out);
+		out << "}" << endl;
+		if (!rootFootprint.fitsArena())
+		{
+			cout << "WARNING: the tree of " << model->path << " used " << rootFootprint.arenaUsedBytes << " bytes of its arena sized for " << rootFootprint.arenaBudgetBytes << "." << endl;
+			return false;
+		}
+		return true;
 	}
-};
 
-/** The bounding sphere implementation of the BVH node. */
-class BSV : public BVH
-{
+	// For the detailed documentation of this method see BVHExample.cpp
+	void refit(BVH& tree) const;
 
 private:
 
-	/** The center of the bounding sphere. */
-	Tuple3f center;
-	/** The radius of the bounding sphere. */
-	float radius;
+	/** The depth of the tree displayed while the final tree of a large model is built (see build()). */
+	static const int PREVIEW_DEPTH = 4;
+	/** The number of triangles from which the models get the preview; the final trees of the smaller ones take less time than the preview would. */
+	static const size_t PREVIEW_TRIANGLES = 100000;
+	/** The number of nodes of a level refitted by a single task (see refit()). */
+	static const size_t REFIT_GRAIN = 1024;
 
-public:
-
-	/** Constructs a new SBB node from the specified values. */
-	BSV(float x, float y, float z, float radius, unordered_set<Triangle*> triangles) : BSV(Tuple3f(x, y, z), radius, triangles)
+	/** Measures the pvs() queries of the given tree (see measureQueries()). */
+	BVHQueryStats measureQueries(const BVH& tree, int directions) const
 	{
-	}
+		BVHQueryStats stats;
+		if (directions <= 0)
+		{
+			return stats;
+		}
 
-	/** Constructs a new SBB node from the specified values. */
-	BSV(Tuple3f center, float radius, unordered_set<Triangle*> triangles) : center(center), radius(radius), BVH(triangles)
-	{
+		Tuple3f min, max;
+		tree.triangles.bounds(0, tree.triangles.size(), min, max);
+		const Tuple3f center((min.x + max.x) / 2, (min.y + max.y) / 2, (min.z + max.z) / 2);
+		const auto start = chrono::steady_clock::now();
+		for (int i = 0; i < directions; i++)
+		{
+			// the Fibonacci sphere
+			const float z = 1 - (2 * i + 1) / static_cast<float>(directions);
+			const float radius = std::sqrt(1 - z * z);
+			const float angle = i * 2.39996323f;
+			const Vector3f normal(radius * std::cos(angle), radius * std::sin(angle), z);
+
+			int tested = 0;
+			int visited = 0;
+			unordered_set<uint32_t> volumes;
+			const size_t visible = pvs(tree, BVH::ROOT, center, normal, Vector3f(1, 0, 0), Vector3f(0, 1, 0), tested, visited, volumes).size();
+			stats.visitedNodes += visited;
+			stats.testedTriangles += tested;
+			stats.visibleTriangles += visible;
+		}
+		stats.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		stats.visitedNodes /= directions;
+		stats.testedTriangles /= directions;
+		stats.visibleTriangles /= directions;
+		stats.milliseconds /= directions;
+		return stats;
 	}
 
-	/** Returns the center of the bounding sphere. */
-	Tuple3f getCenter() const
+	/**
+	* The method initializes the visualization and starts the worker constructing the BVH tree (and loading the model first if needed).
+	* The previous tree stays displayed until the worker publishes the first level of the new one.
+	*/
+	void init()
 	{
-		return center;
+		stopWorker();
+		{
+			lock_guard<mutex> lock(workerMutex);
+			discardPendingTree();
+			loadingStatus.clear();
+			loadingProgress = 0;
+		}
+
+		highlightVisible = false;
+		dirty = true;
+		loading = true;
+		worker = thread(&BVHExample::build, this);
 	}
 
-	/** Returns the radius of the bounding sphere. */
-	float getRadius() const
+	/** Asks the worker to stop after its current step and waits for it. Must be called before changing any setting the worker reads. */
+	void stopWorker()
 	{
-		return radius;
+		cancelLoading = true;
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+		cancelLoading = false;
+		loading = false;
 	}
 
 	/**
-	 * Sets a new center for this node.
-	 */
-	void setCenter(Tuple3f center) {
-		this->center = center;
-	}
-
-	/** Sets a new radius for this node. */
-	void setRadius(float radius) {
-		this->radius = radius;
-	}
-
-	/** Renders the node with a specified color. */
-	void render(Color color, GLfloat matrix[4][4]) {
-		glColor3f(color.r, color.g, color.b);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-		int num_segments = 50;
-
-		glPushMatrix();
-		GLfloat transpose[4][4];
-		transpose[0][0] = matrix[0][0];
-		transpose[1][0] = matrix[0][1];
-		transpose[2][0] = matrix[0][2];
-		transpose[3][0] = matrix[0][3];
-
-		transpose[0][1] = matrix[1][0];
-		transpose[1][1] = matrix[1][1];
-		transpose[2][1] = matrix[1][2];
-		transpose[3][1] = matrix[1][3];
-
-		transpose[0][2] = matrix[2][0];
-		transpose[1][2] = matrix[2][1];
-		transpose[2][2] = matrix[2][2];
-		transpose[3][2] = matrix[2][3];
-
-		transpose[0][3] = matrix[3][0];
-		transpose[1][3] = matrix[3][1];
-		transpose[2][3] = matrix[3][2];
-		transpose[3][3] = matrix[3][3];
-
-		glTranslatef(center.x, center.y, center.z);
-
-		/*glBegin(GL_LINE_STRIP);
-		for (int ii = 0; ii < num_segments + 1; ii++) {
-			float theta = 2.0f * 3.1415926f * (float)ii / (float)num_segments;
+	* Runs on the worker thread: acquires the model from the scene (loading it if needed) and constructs the tree.
+	* The models with at least PREVIEW_TRIANGLES triangles first get a single tree of PREVIEW_DEPTH levels, which is displayed while the final tree is built.
+	* The preview is a separate construction: it repeats about PREVIEW_DEPTH passes over the triangles of the final build, and the window collects
+	* the footprint of the preview as well, so the smaller models, whose final tree takes a few milliseconds, are built at once.
+	* The final tree is kept by the model, so switching back to a model held by the scene needs no rebuild.
+	*/
+	void build()
+	{
+		int step = 0;
 
-			float u = radius * (float)cos(theta);
-			float v = radius * (float)sin(theta);
-			glVertex3f(u, v, 0);
+		setLoadingStatus("Loading " + modelPath, 0);
+		SceneModel* loaded = scene.acquire(modelPath);
+		if (loaded == nullptr)
+		{
+			setLoadingStatus("The file " + modelPath + " could not be loaded", 0);
+			loading = false;
+			return;
 		}
-		glEnd();
-
-		glBegin(GL_LINE_STRIP);
-		for (int ii = 0; ii < num_segments + 1; ii++) {
-			float theta = 2.0f * 3.1415926f * (float)ii / (float)num_segments;
-
-			float u = radius * (float)cos(theta);
-			float v = radius * (float)sin(theta);
-			glVertex3f(u, 0, v);
+		if (loaded != model)
+		{
+			// the window displays no tree of another model while the worker runs, so it does not read the model now
+			lock_guard<mutex> lock(workerMutex);
+			model = loaded;
 		}
-		glEnd();
-
-		glBegin(GL_LINE_STRIP);
-		for (int ii = 0; ii < num_segments + 1; ii++) {
-			float theta = 2.0f * 3.1415926f * (float)ii / (float)num_segments;
-
-			float u = radius * (float)cos(theta);
-			float v = radius * (float)sin(theta);
-			glVertex3f(0, u, v);
+		scene.setQuantizedVertices(model, useQuantizedVertices);
+		step++;
+		// the steps are the load, the preview (if any), and the final tree
+		const bool preview = maxDepth > PREVIEW_DEPTH && model->geometry.size() >= PREVIEW_TRIANGLES;
+		const int steps = preview ? 3 : 2;
+
+		const auto start = chrono::steady_clock::now();
+		BVHCacheKey key;
+		key.meshHash = model->meshHash;
+		key.volumeType = volumeType;
+		key.maxDepth = maxDepth;
+		key.settingsHash = BVHCache::hashBytes(&useQuantizedVertices, sizeof(useQuantizedVertices));
+		key.settingsHash = BVHCache::hashBytes(&splitMethod, sizeof(splitMethod), key.settingsHash);
+		key.settingsHash = BVHCache::hashBytes(&binCount, sizeof(binCount), key.settingsHash);
+		key.settingsHash = BVHCache::hashBytes(&maxLeafTriangles, sizeof(maxLeafTriangles), key.settingsHash);
+		key.settingsHash = BVHCache::hashBytes(&partitionByCentroids, sizeof(partitionByCentroids), key.settingsHash);
+		key.settingsHash = BVHCache::hashBytes(&duplicationBudget, sizeof(duplicationBudget), key.settingsHash);
+
+		if (model->hasTree(key))
+		{
+			publishTree(model->root, maxDepth, key, true);
+			loading = false;
+			return;
 		}
-		glEnd();*/
-
-		glMultMatrixf(&transpose[0][0]);
 
-		glBegin(GL_LINE_STRIP);
-		for (int ii = 0; ii < num_segments + 1; ii++) {
-			float theta = 2.0f * 3.1415926f * (float)ii / (float)num_segments;
-
-			float u = radius * (float)cos(theta);
-			float v = radius * (float)sin(theta);
-			glVertex3f(u, v, 0);
+		BVH* cached = useCache && !cancelLoading ? BVHCache::load(key, model->mesh) : nullptr;
+		if (cached != nullptr)
+		{
+			if (useQuantizedVertices)
+			{
+				cached->triangles.setQuantization(model->quantizedMesh.getOrigin(), model->quantizedMesh.getStep());
+			}
+			fillTriangleStore(TriangleRange(cached->references.data(), cached->references.data() + cached->references.size()), cached->triangles);
+			cout << "BVH loaded from " << BVHCache::path(key) << " in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms." << endl;
+			publishTree(cached, maxDepth, key, true);
+			loading = false;
+			return;
 		}
-		glEnd();
 
-		glPopMatrix();
+		if (preview && !cancelLoading)
+		{
+			setLoadingStatus("Building the BVH preview (depth " + to_string(PREVIEW_DEPTH) + ")", static_cast<float>(step) / steps);
+			publishTree(construct(model->geometry, PREVIEW_DEPTH, volumeType), PREVIEW_DEPTH, key, false);
+			step++;
+		}
+		if (!cancelLoading)
+		{
+			setLoadingStatus("Building the BVH (depth " + to_string(maxDepth) + ")", static_cast<float>(step) / steps);
+			const auto finalStart = chrono::steady_clock::now();
+			BVH* tree = construct(model->geometry, maxDepth, volumeType);
+			cout << "BVH constructed in " << chrono::duration<double, milli>(chrono::steady_clock::now() - finalStart).count() << " ms ("
+				<< chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms including the preview)." << endl;
+			if (useCache && !BVHCache::save(key, tree, model->mesh))
+			{
+				cout << "WARNING: the BVH could not be stored in the cache." << endl;
+			}
+			publishTree(tree, maxDepth, key, true);
+		}
+		loading = false;
 	}
-};
-
-enum VolumeType
-{
-	AxisAlignedBoundingBox, Sphere
-};
 
-/**
- * The example for experimenting with BVH.
- * Code for handling interactions and rendering of the window is in this header.
- * The *.cpp file is designated for the implementation of the actual algorithms by students.
- *
- * @author	<a href="mailto:jan.byska@gmail.com">Jan Byška</a>
- */
-class BVHExample : public BaseWindow
-{
-
-private:
-
-	/** The set of triangles defining the geometry. */
-	unordered_set<Triangle*> geometry;
-	/** The path to the raw file from which the geometry will be loaded. */
-	static const string PATH;
-	/** The flag determining whether to use AxisAlignedBoundBox or Spheres for building the BVH tree. */
-	VolumeType volumeType = VolumeType::AxisAlignedBoundingBox;
-
-	/** The set of volumes that were tested during the tracing of the BVH tree. */
-	unordered_set<BVH*> visibleVolumes;
-	/** The set of visible triangles that were. */
-	unordered_set<Triangle*> visibleTriangles;
-	/** The number of triangles in visible bounding boxes (at the lowest level). */
-	int trianglesInVolumes = 0;
-	/** The actual number of triangles student returned. */
-	int testedTriangles = 0;
-
-	/** The root of the BVH tree. */
-	BVH* root;
-	/** The currently selected node in the BVH tree. */
-	BVH* current;
-	/** The currently displayed level of the hierarchy */
-	int displayLevel = 0;
-	/** The maximum depth of the tree. */
-	int maxDepth = 4;
+	/** Sets the loading status displayed by the window (called by the worker). */
+	void setLoadingStatus(const string& status, float progress)
+	{
+		lock_guard<mutex> lock(workerMutex);
+		loadingStatus = status;
+		loadingProgress = progress;
+	}
 
-	/** If true the visible triangles will be highlighted. */
-	bool highlightVisible = true;
-	/** The flag determining if the visible triangles needs to be recomputed. */
-	bool dirty = true;
+	/**
+	* Hands the finished tree over to the window (called by the worker); a pending tree that was not displayed yet is replaced.
+	*
+	* @param tree	The tree.
+	* @param depth	The depth the tree was built with.
+	* @param key	The cache key of the final tree of the model.
+	* @param final	True for the final tree, which is handed over to the model; false for a preview, which the example deletes when it is replaced.
+	*/
+	void publishTree(BVH* tree, int depth, const BVHCacheKey& key, bool final)
+	{
+		lock_guard<mutex> lock(workerMutex);
+		discardPendingTree();
+		pendingRoot = tree;
+		pendingDepth = depth;
+		pendingKey = key;
+		pendingFinal = final;
+	}
 
-	/** The current camera position. */
-	Tuple3f cameraPosition = Vector3f(0, 0, 0);
-	/** The current left vector of the camera. */
-	Vector3f cameraX = Vector3f(1, 0, 0);
-	/** The current up vector of the camera. */
-	Vector3f cameraY = Vector3f(0, 1, 0);
-	/** The current direction vector of the camera. */
-	Vector3f cameraZ = Vector3f(0, 0, 1);
-public:
+	/** Deletes the pending tree unless it is owned by the model; the worker mutex must be locked. */
+	void discardPendingTree()
+	{
+		if (model == nullptr || pendingRoot != model->root)
+		{
+			delete pendingRoot;
+		}
+		pendingRoot = nullptr;
+	}
 
-	/** Creates the new example window and loads the geometry.  */
-	BVHExample()
+	/** Collapses the displayed tree into the wide tree of the selected branching factor; the previous wide tree is deleted. */
+	void updateWideRoot()
 	{
-		geometry = load();
-		init();
+		delete wideRoot4;
+		delete wideRoot8;
+		wideRoot4 = root != nullptr && branchingFactor == 4 ? new WideBVH<4>(*root) : nullptr;
+		wideRoot8 = root != nullptr && branchingFactor == 8 ? new WideBVH<8>(*root) : nullptr;
 	}
 
-	/** Releases allocated memory on example destruction. */
-	~BVHExample()
+	/** Stops displaying the tree and deletes it if it is owned by the example. */
+	void releaseRoot()
 	{
-		for (unordered_set<Triangle*>::iterator it = geometry.begin(); it != geometry.end(); it++)
+		delete wideRoot4;
+		delete wideRoot8;
+		wideRoot4 = nullptr;
+		wideRoot8 = nullptr;
+		if (ownsRoot)
 		{
-			delete* it;
+			delete root;
 		}
-		geometry.clear();
-		deleteTree(root);
+		root = nullptr;
+		current = BVH::ROOT;
+		parents.clear();
+		currentTrianglesNode = BVH_NO_NODE;
+		ownsRoot = true;
 	}
 
-	/** Deletes the allocated memory for the tree. */
-	static void deleteTree(BVH* node)
+	/**
+	* Replaces the displayed tree by the tree published by the worker (if any); returns true if the tree was replaced.
+	* The final tree is handed over to the model, which may evict other models from the scene.
+	*/
+	bool adoptPendingTree()
 	{
-		if (node != nullptr) {
-			if (node->getLeft() != nullptr)
-				deleteTree(node->getLeft());
-			if (node->getRight() != nullptr)
-				deleteTree(node->getRight());
-			delete node;
+		lock_guard<mutex> lock(workerMutex);
+		if (pendingRoot == nullptr)
+		{
+			return false;
 		}
-	}
 
-private:
+		BVH* previous = root;
+		const bool ownedPrevious = ownsRoot;
+		root = pendingRoot;
+		rootDepth = pendingDepth;
+		pendingRoot = nullptr;
+		// the wide tree refers to the displayed tree, so it is replaced before the previous tree is deleted
+		updateWideRoot();
+
+		// the previous final tree is deleted by the model, the previous coarse tree by the example
+		ownsRoot = !pendingFinal;
+		if (!ownsRoot)
+		{
+			scene.setTree(model, root, pendingKey);
+		}
+		if (ownedPrevious)
+		{
+			delete previous;
+		}
 
-	/** The method initializes the visualization and constructs the BVH tree. */
-	void init()
-	{
-		root = construct(geometry, maxDepth, volumeType);
-		current = root;
+		current = BVH::ROOT;
+		parents = root->getParents();
+		rootFootprint = root->footprint();
+		currentTrianglesNode = BVH_NO_NODE;
 		displayLevel = 0;
-		highlightVisible = false;
 		dirty = true;
+		return true;
+	}
+
+	/** Redraws the window so it picks up the progress of the worker. */
+	static void refreshCallback(int)
+	{
+		refreshScheduled = false;
+		glutPostRedisplay();
 	}
 
 protected:
@@ -430,7 +730,55 @@ protected:
 		case 'v':
 			highlightVisible = !highlightVisible;
 			break;
+		case 'b':
+			stopWorker();
+			useQuantizedVertices = !useQuantizedVertices;
+			init();
+			break;
+		case 'h':
+			// the midpoint, the binned SAH with 8, 16, and 32 bins per axis, the SBVH with 32 bins, and the Morton codes
+			stopWorker();
+			if (splitMethod == SplitMethod::Midpoint)
+			{
+				splitMethod = SplitMethod::BinnedSAH;
+				binCount = 8;
+			}
+			else if (splitMethod == SplitMethod::BinnedSAH && binCount < 32)
+			{
+				binCount *= 2;
+			}
+			else if (splitMethod == SplitMethod::BinnedSAH)
+			{
+				splitMethod = SplitMethod::Spatial;
+			}
+			else if (splitMethod == SplitMethod::Spatial)
+			{
+				splitMethod = SplitMethod::Morton;
+			}
+			else
+			{
+				splitMethod = SplitMethod::Midpoint;
+			}
+			init();
+			break;
+		case 'p':
+			stopWorker();
+			partitionByCentroids = !partitionByCentroids;
+			init();
+			break;
+		case 'n':
+			branchingFactor = branchingFactor == 8 ? 2 : branchingFactor * 2;
+			updateWideRoot();
+			dirty = true;
+			break;
+		case 'm':
+			stopWorker();
+			releaseRoot();
+			modelPath = nextModel();
+			init();
+			break;
 		case 'g':
+			stopWorker();
 			if (volumeType == VolumeType::AxisAlignedBoundingBox) {
 				volumeType = VolumeType::Sphere;
 			}
@@ -499,89 +847,54 @@ protected:
 	void specialInput(int key, int x, int y) override
 	{
 		BaseWindow::specialInput(key, x, y);
+		if (root == nullptr)
+		{
+			return;
+		}
 		switch (key)
 		{
 		case GLUT_KEY_DOWN:
 
-			if (current->getLeft() != nullptr)
+			if (!(*root)[current].isLeaf())
 			{
-				current = current->getLeft();
+				current = root->getLeft(current);
 				displayLevel++;
 			}
 			highlightVisible = false;
 			break;
 		case GLUT_KEY_UP:
-			if (current->getParent() != nullptr)
+			if (parents[current] != BVH_NO_NODE)
 			{
-				current = current->getParent();
+				current = parents[current];
 				displayLevel--;
 			}
 			highlightVisible = false;
 			break;
 		case GLUT_KEY_LEFT:
-			if (current->getParent() != nullptr)
+			if (parents[current] != BVH_NO_NODE)
 			{
-				current = current->getParent()->getLeft();
+				current = root->getLeft(parents[current]);
 			}
 			break;
 		case GLUT_KEY_RIGHT:
-			if (current->getParent() != nullptr)
+			if (parents[current] != BVH_NO_NODE)
 			{
-				current = current->getParent()->getRight();
+				current = root->getRight(parents[current]);
 			}
 			break;
 		}
 	}
 
-	/** Loads the geometry from the raw file defined by PATH. */
-	unordered_set<Triangle*> load()
+	/** Returns the path to the model following the displayed one in SceneManager::DIRECTORY (wrapping around). */
+	string nextModel() const
 	{
-		ifstream file(PATH);
-		vector<float> raw;
-		if (file.is_open())
+		const vector<string> paths = SceneManager::listModels();
+		if (paths.empty())
 		{
-			float vertex;
-			while (file >> vertex) {
-				raw.push_back(vertex);
-			}
-		}
-
-		if (raw.size() % 3 != 0)
-		{
-			cout << "WARNING: some vertices are missing.";
+			return modelPath;
 		}
-
-		Tuple3f boundingMin = Tuple3f(numeric_limits<float>::max(), numeric_limits<float>::max(), numeric_limits<float>::max());
-		Tuple3f boundingMax = Tuple3f(numeric_limits<float>::min(), numeric_limits<float>::min(), numeric_limits<float>::min());
-		for (size_t i = 0; i < raw.size(); i += 3) {
-			boundingMin.x = std::min(boundingMin.x, raw[i]);
-			boundingMin.y = std::min(boundingMin.y, raw[i + 1]);
-			boundingMin.z = std::min(boundingMin.z, raw[i + 2]);
-
-			boundingMax.x = std::max(boundingMax.x, raw[i]);
-			boundingMax.y = std::max(boundingMax.y, raw[i + 1]);
-			boundingMax.z = std::max(boundingMax.z, raw[i + 2]);
-		}
-		float dist = std::max({ boundingMax.x - boundingMin.x, boundingMax.y - boundingMin.y, boundingMax.z - boundingMin.z });
-
-		const float scale = 2.f / dist;
-		const Tuple3f center = (boundingMin + boundingMax) / 2;
-
-		unordered_set<Triangle*> triangles;
-
-		for (size_t i = 0; i < raw.size(); i += 9) {
-			const Tuple3f v1 = (Tuple3f(raw[i], raw[i + 1], raw[i + 2]) - center) * scale;
-			const Tuple3f v2 = (Tuple3f(raw[i + 3], raw[i + 4], raw[i + 5]) - center) * scale;
-			const Tuple3f v3 = (Tuple3f(raw[i + 6], raw[i + 7], raw[i + 8]) - center) * scale;
-
-			triangles.insert(new Triangle(v1, v2, v3));
-		}
-
-		// center the min and max for display
-		boundingMin = (boundingMin - center) * scale;
-		boundingMax = (boundingMax - center) * scale;
-
-		return triangles;
+		auto next = upper_bound(paths.begin(), paths.end(), modelPath);
+		return next != paths.end() ? *next : paths.front();
 	}
 
 	/** Helper method that renders a given text on the screen. */
@@ -600,6 +913,18 @@ protected:
 	{
 		BaseWindow::render();
 
+		adoptPendingTree();
+		if (loading && !refreshScheduled)
+		{
+			refreshScheduled = true;
+			glutTimerFunc(REFRESH_INTERVAL, refreshCallback, 0);
+		}
+		if (root == nullptr)
+		{
+			renderProgress();
+			return;
+		}
+
 		////////////// LEFT //////////////
 		glViewport(0, 0, this->width / 2.0f, this->height);
 		glPushMatrix();
@@ -608,18 +933,37 @@ protected:
 			visibleVolumes.clear();
 			trianglesInVolumes = 0;
 			testedTriangles = 0;
-			visibleTriangles = pvs(root, cameraPosition, cameraZ, cameraX, cameraY, testedTriangles, visibleVolumes);
+			visitedNodes = 0;
+			if (wideRoot4 != nullptr)
+			{
+				visibleTriangles = pvs(*wideRoot4, cameraPosition, cameraZ, testedTriangles, visitedNodes, visibleVolumes);
+			}
+			else if (wideRoot8 != nullptr)
+			{
+				visibleTriangles = pvs(*wideRoot8, cameraPosition, cameraZ, testedTriangles, visitedNodes, visibleVolumes);
+			}
+			else
+			{
+				visibleTriangles = pvs(*root, BVH::ROOT, cameraPosition, cameraZ, cameraX, cameraY, testedTriangles, visitedNodes, visibleVolumes);
+			}
 			dirty = false;
 
 			for (auto volume : visibleVolumes)
 			{
-				if (volume->isLeaf())
+				if ((*root)[volume].isLeaf())
 				{
-					trianglesInVolumes += volume->getTriangles().size();
+					trianglesInVolumes += (*root)[volume].getCount();
 				}
 			}
 		}
 
+		if (currentTrianglesNode != current)
+		{
+			const TriangleRange triangles = root->getTriangles(current);
+			currentTriangles = unordered_set<Triangle*>(triangles.begin(), triangles.end());
+			currentTrianglesNode = current;
+		}
+
 		renderCurrentLevel();
 		renderCamera();
 		if (highlightVisible)
@@ -641,7 +985,7 @@ protected:
 			cameraY.x, cameraY.y, cameraY.z
 		);
 
-		renderNode(root, Color::DEFAULT_COLOR, false);
+		renderNode(BVH::ROOT, Color::DEFAULT_COLOR, false);
 		glPopMatrix();
 
 		////////////// LABELS //////////////
@@ -655,17 +999,88 @@ protected:
 		glLoadIdentity();
 
 		stringstream ss;
-		ss << "Depth: " << displayLevel;
+		ss << "Depth: " << displayLevel << (useQuantizedVertices ? " (16-bit vertices)" : "") << (branchingFactor > 2 ? ", BVH" + to_string(branchingFactor) + " traversal" : "")
+			<< (splitMethod == SplitMethod::BinnedSAH ? ", SAH with " + to_string(binCount) + " bins" : "")
+			<< (splitMethod == SplitMethod::Spatial ? ", SBVH with " + to_string(binCount) + " bins" : "")
+			<< (splitMethod == SplitMethod::Morton ? ", Morton LBVH" : "")
+			<< (partitionByCentroids && (splitMethod == SplitMethod::Midpoint || splitMethod == SplitMethod::BinnedSAH) ? ", centroid partition" : "");
 		displayText(-0.99, -0.7, 1, 1, 0, ss.str().c_str());
 
 		ss.str(std::string());
-		ss << "Triangles: " << geometry.size() << ", In Node: " << current->getTriangles().size() << " In Parent: " << (current->getParent() != nullptr ? current->getParent()->getTriangles().size() : 0);
+		ss << "Triangles: " << model->geometry.size() << ", In Node: " << root->getTriangles(current).size() << " In Parent: " << (parents[current] != BVH_NO_NODE ? root->getTriangles(parents[current]).size() : 0);
 		displayText(-0.99, -0.8, 1, 1, 0, ss.str().c_str());
 
 		ss.str(std::string());
-		ss << "Max to Test: " << trianglesInVolumes << ", Actually Tested: " << testedTriangles << ", PVS: " << visibleTriangles.size();
+		ss << "Max to Test: " << trianglesInVolumes << ", Actually Tested: " << testedTriangles << ", PVS: " << visibleTriangles.size() << ", Visited Nodes: " << visitedNodes;
 		displayText(-0.99, -0.9, 1, 1, 0, ss.str().c_str());
 
+		ss.str(std::string());
+		ss << model->path << ", Scene: " << scene.modelCount() << " models, " << scene.memoryBytes() / 1024 << " KB of " << scene.getBudget() / 1024 << " KB";
+		displayText(-0.99, 0.9, 1, 1, 0, ss.str().c_str());
+
+		ss.str(std::string());
+		ss << "Tree: " << rootFootprint.totalBytes / 1024 << " KB, Nodes: " << rootFootprint.nodeCount << " (" << rootFootprint.nodeBytes / 1024 << " KB)"
+			<< ", References: " << rootFootprint.referenceCount << " of " << rootFootprint.uniqueTriangles << " triangles (" << fixed << setprecision(2) << rootFootprint.duplicationFactor() << defaultfloat << "x, "
+			<< rootFootprint.referenceBytes / 1024 << " KB), Vertices: " << rootFootprint.triangleStoreBytes / 1024 << " KB";
+		displayText(-0.99, 0.8, 1, 1, 0, ss.str().c_str());
+
+		if (loading)
+		{
+			ss.str(std::string());
+			{
+				lock_guard<mutex> lock(workerMutex);
+				ss << "Refining (depth " << rootDepth << " shown): " << loadingStatus;
+			}
+			displayText(-0.99, -0.6, 1, 1, 0, ss.str().c_str());
+		}
+
+		glMatrixMode(GL_PROJECTION);
+		glPopMatrix();
+		glMatrixMode(GL_MODELVIEW);
+		glPopMatrix();
+	}
+
+	/** Renders the loading status and the progress bar of the worker while there is no tree to display. */
+	void renderProgress()
+	{
+		string status;
+		float progress;
+		{
+			lock_guard<mutex> lock(workerMutex);
+			status = loadingStatus;
+			progress = loadingProgress;
+		}
+
+		glViewport(0, 0, this->width, this->height);
+		glMatrixMode(GL_MODELVIEW);
+		glPushMatrix();
+		glLoadIdentity();
+
+		glMatrixMode(GL_PROJECTION);
+		glPushMatrix();
+		glLoadIdentity();
+
+		stringstream ss;
+		ss << status << " (" << static_cast<int>(progress * 100) << " %)";
+		displayText(-0.5, 0.05, 1, 1, 0, ss.str().c_str());
+
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glColor3f(1, 1, 0);
+		glBegin(GL_QUADS);
+		glVertex2f(-0.5, -0.05);
+		glVertex2f(-0.5 + progress, -0.05);
+		glVertex2f(-0.5 + progress, -0.02);
+		glVertex2f(-0.5, -0.02);
+		glEnd();
+
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		glBegin(GL_QUADS);
+		glVertex2f(-0.5, -0.05);
+		glVertex2f(0.5, -0.05);
+		glVertex2f(0.5, -0.02);
+		glVertex2f(-0.5, -0.02);
+		glEnd();
+
 		glMatrixMode(GL_PROJECTION);
 		glPopMatrix();
 		glMatrixMode(GL_MODELVIEW);
@@ -675,11 +1090,11 @@ protected:
 	/** Renders the current level of hierarchy. */
 	void renderCurrentLevel()
 	{
-		if (current->getParent() != nullptr)
+		if (parents[current] != BVH_NO_NODE)
 		{
 			// NOT ROOT
-			BVH* left = current->getParent()->getLeft();
-			BVH* right = current->getParent()->getRight();
+			const uint32_t left = root->getLeft(parents[current]);
+			const uint32_t right = root->getRight(parents[current]);
 
 			renderNode(left, Color::DEFAULT_COLOR, true);
 			renderNode(right, Color::DEFAULT_COLOR, true);
@@ -687,36 +1102,36 @@ protected:
 		else
 		{
 			// ROOT
-			current->render(highlightVisible && visibleVolumes.find(current) != visibleVolumes.end() ? Color::ORANGE : Color::GREEN, matrix);
+			root->render(current, highlightVisible && visibleVolumes.find(current) != visibleVolumes.end() ? Color::ORANGE : Color::GREEN, matrix);
 			renderNode(current, Color::GREEN, true);
 		}
 	}
 
 	/** Renders triangles in the given node with the specified color. */
-	void renderNode(BVH* node, Color color, bool renderVolume)
+	void renderNode(uint32_t node, Color color, bool renderVolume)
 	{
 		if (renderVolume) {
 			if (highlightVisible && visibleVolumes.find(node) != visibleVolumes.end())
 			{
-				node->render(Color::ORANGE, matrix);
+				root->render(node, Color::ORANGE, matrix);
 			}
 			else if (current == node) {
-				node->render(Color::GREEN, matrix);
+				root->render(node, Color::GREEN, matrix);
 			}
 			else
 			{
-				node->render(color, matrix);
+				root->render(node, color, matrix);
 			}
 		}
 
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		for (Triangle* triangle : node->getTriangles())
+		for (Triangle* triangle : root->getTriangles(node))
 		{
 			if (highlightVisible && visibleTriangles.find(triangle) != visibleTriangles.end()) // visible triangles
 			{
 				triangle->render(Color::ORANGE);
 			}
-			else if (current->getTriangles().find(triangle) != current->getTriangles().end()) // current triangles
+			else if (currentTriangles.find(triangle) != currentTriangles.end()) // current triangles
 			{
 				triangle->render(Color::GREEN);
 			}
@@ -803,10 +1218,41 @@ protected:
 	/******************************************************************************************************************/
 	
 	// For the detailed documentation of this method see BVHExample.cpp
-	BVH* construct(const unordered_set<Triangle*> & triangles, int depth, VolumeType volumeType) const;
+	BVH* construct(const vector<Triangle*> & triangles, int depth, VolumeType volumeType) const;
+
+	// For the detailed documentation of this method see BVHExample.cpp
+	template <class Volume>
+	void constructRange(BVHBuildWork& work, size_t first, size_t last, int depth, BVH& tree) const;
+
+	// For the detailed documentation of this method see BVHExample.cpp
+	template <class Volume, typename Code>
+	void constructLinear(BVHBuildWork& work, int depth, BVH& tree) const;
+
+	// For the detailed documentation of this method see BVHExample.cpp
+	template <class Volume, typename Code>
+	uint32_t emitLinear(BVHBuildWork& work, const vector<Code>& codes, size_t first, size_t last, int depth, BVH& tree) const;
+
+	// For the detailed documentation of this method see BVHExample.cpp
+	template <class Volume>
+	void refitLevels(BVH& tree) const;
+
+	// For the detailed documentation of this method see BVHExample.cpp
+	void fillTriangleStore(TriangleRange triangles, TriangleSoA& store) const;
+
+	// For the detailed documentation of this method see BVHExample.cpp
+	unordered_set<Triangle*> pvs(const BVH& tree, uint32_t node, const Tuple3f cameraPosition, const Vector3f cameraNormal, const Vector3f cameraRightVector, const Vector3f cameraUpVector, int& testedTriangles, int& visitedNodes, unordered_set<uint32_t>& visibleVolumes) const;
+
+	// For the detailed documentation of this method see BVHExample.cpp
+	template <int WIDTH>
+	unordered_set<Triangle*> pvs(const WideBVH<WIDTH>& tree, const Tuple3f cameraPosition, const Vector3f cameraNormal, int& testedTriangles, int& visitedNodes, unordered_set<uint32_t>& visibleVolumes) const;
+
+	// For the detailed documentation of this method see BVHExample.cpp
+	template <class Volume>
+	unordered_set<Triangle*> traverse(const BVH& tree, uint32_t node, const Tuple3f& cameraPosition, const Vector3f& cameraNormal, int& testedTriangles, int& visitedNodes, unordered_set<uint32_t>& visibleVolumes) const;
 
 	// For the detailed documentation of this method see BVHExample.cpp
-	unordered_set<Triangle*> pvs(BVH* node, const Tuple3f cameraPosition, const Vector3f cameraNormal, const Vector3f cameraRightVector, const Vector3f cameraUpVector, int& testedTriangles, unordered_set<BVH*>& visibleVolumes) const;
+	template <class Volume, int WIDTH>
+	unordered_set<Triangle*> traverse(const WideBVH<WIDTH>& tree, const Tuple3f& cameraPosition, const Vector3f& cameraNormal, int& testedTriangles, int& visitedNodes, unordered_set<uint32_t>& visibleVolumes) const;
 
 };
 
@@ -0,0 +1,252 @@
+#include "BVHImage.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+/** The tolerance of the camera plane test; the same as used by BVHExample::pvs. */
+static const float VISIBILITY_EPSILON = 0.000001f;
+
+/** Rounds the given offset up to the section alignment. */
+static uint64_t align(const uint64_t offset)
+{
+	return (offset + 15) & ~static_cast<uint64_t>(15);
+}
+
+/** Converts the nodes of the tree; both are in the pre-order, so the indices of the nodes stay the same. */
+static vector<BVHImageNode> convertNodes(const BVH& tree)
+{
+	vector<BVHImageNode> nodes(tree.size());
+	for (uint32_t i = 0; i < tree.size(); i++)
+	{
+		const BVHNode& node = tree[i];
+		BVHImageNode& image = nodes[i];
+		memcpy(image.bounds, node.bounds, sizeof(image.bounds));
+
+		const TriangleRange triangles = tree.getTriangles(i);
+		image.firstReference = node.begin;
+		image.referenceCount = static_cast<uint32_t>(triangles.size());
+		image.left = node.isLeaf() ? BVH_IMAGE_NO_CHILD : tree.getLeft(i);
+		image.right = node.isLeaf() ? BVH_IMAGE_NO_CHILD : tree.getRight(i);
+	}
+	return nodes;
+}
+
+bool BVHImage::write(const string& path, const BVH* tree, const IndexedMesh& mesh)
+{
+	if (tree == nullptr || tree->size() == 0)
+	{
+		return false;
+	}
+
+	const vector<BVHImageNode> nodes = convertNodes(*tree);
+	vector<uint32_t> references;
+	references.reserve(tree->references.size());
+	for (Triangle* triangle : tree->references)
+	{
+		references.push_back(static_cast<uint32_t>(mesh.indexOf(triangle)));
+	}
+
+	BVHImageHeader header = {};
+	memcpy(header.magic, BVH_IMAGE_MAGIC, sizeof(BVH_IMAGE_MAGIC));
+	header.version = BVH_IMAGE_VERSION;
+	header.volumeType = tree->volumeType;
+	header.nodeCount = static_cast<uint32_t>(nodes.size());
+	header.referenceCount = static_cast<uint32_t>(references.size());
+	header.triangleCount = static_cast<uint32_t>(mesh.triangleCount());
+	header.vertexCount = static_cast<uint32_t>(mesh.vertexCount());
+	header.nodesOffset = align(sizeof(BVHImageHeader));
+	header.referencesOffset = align(header.nodesOffset + nodes.size() * sizeof(BVHImageNode));
+	header.verticesOffset = align(header.referencesOffset + references.size() * sizeof(uint32_t));
+	header.indicesOffset = align(header.verticesOffset + mesh.vertexCount() * 3 * sizeof(float));
+	header.size = header.indicesOffset + mesh.indices.size() * sizeof(uint32_t);
+
+	vector<char> image(header.size, 0);
+	memcpy(image.data(), &header, sizeof(header));
+	memcpy(image.data() + header.nodesOffset, nodes.data(), nodes.size() * sizeof(BVHImageNode));
+	memcpy(image.data() + header.referencesOffset, references.data(), references.size() * sizeof(uint32_t));
+	float* vertices = reinterpret_cast<float*>(image.data() + header.verticesOffset);
+	for (const Tuple3f& vertex : mesh.vertices)
+	{
+		*vertices++ = vertex.x;
+		*vertices++ = vertex.y;
+		*vertices++ = vertex.z;
+	}
+	memcpy(image.data() + header.indicesOffset, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+
+	ofstream file(path, ios::binary | ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	file.write(image.data(), static_cast<streamsize>(image.size()));
+	return file.good();
+}
+
+BVHImage::BVHImage(const string& path) : file(path)
+{
+	if (!file.isOpen() || file.size() < sizeof(BVHImageHeader))
+	{
+		return;
+	}
+
+	const BVHImageHeader* candidate = reinterpret_cast<const BVHImageHeader*>(file.data());
+	if (memcmp(candidate->magic, BVH_IMAGE_MAGIC, sizeof(BVH_IMAGE_MAGIC)) != 0 || candidate->version != BVH_IMAGE_VERSION || candidate->size != file.size())
+	{
+		return;
+	}
+
+	header = candidate;
+	nodes = reinterpret_cast<const BVHImageNode*>(file.data() + header->nodesOffset);
+	references = reinterpret_cast<const uint32_t*>(file.data() + header->referencesOffset);
+	vertices = reinterpret_cast<const float*>(file.data() + header->verticesOffset);
+	indices = reinterpret_cast<const uint32_t*>(file.data() + header->indicesOffset);
+	if (!validate())
+	{
+		header = nullptr;
+	}
+}
+
+bool BVHImage::validate() const
+{
+	const uint64_t size = header->size;
+	const auto fits = [size](uint64_t offset, uint64_t bytes) { return offset % 16 == 0 && offset <= size && bytes <= size - offset; };
+	if (header->volumeType > VolumeType::Sphere || header->nodeCount == 0
+		|| !fits(header->nodesOffset, static_cast<uint64_t>(header->nodeCount) * sizeof(BVHImageNode))
+		|| !fits(header->referencesOffset, static_cast<uint64_t>(header->referenceCount) * sizeof(uint32_t))
+		|| !fits(header->verticesOffset, static_cast<uint64_t>(header->vertexCount) * 3 * sizeof(float))
+		|| !fits(header->indicesOffset, static_cast<uint64_t>(header->triangleCount) * 3 * sizeof(uint32_t)))
+	{
+		return false;
+	}
+
+	// the children always follow their parent in the pre-order, which also rules out cycles
+	for (uint32_t i = 0; i < header->nodeCount; i++)
+	{
+		const BVHImageNode& node = nodes[i];
+		if ((node.left != BVH_IMAGE_NO_CHILD && (node.left <= i || node.left >= header->nodeCount))
+			|| (node.right != BVH_IMAGE_NO_CHILD && (node.right <= i || node.right >= header->nodeCount))
+			|| node.firstReference > header->referenceCount || node.referenceCount > header->referenceCount - node.firstReference)
+		{
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < header->referenceCount; i++)
+	{
+		if (references[i] >= header->triangleCount)
+		{
+			return false;
+		}
+	}
+	for (uint64_t i = 0; i < static_cast<uint64_t>(header->triangleCount) * 3; i++)
+	{
+		if (indices[i] >= header->vertexCount)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int BVHImage::classify(const BVHImageNode& node, const Tuple3f& cameraPosition, const Vector3f& cameraNormal) const
+{
+	float nearest;
+	float farthest;
+	if (header->volumeType == VolumeType::Sphere)
+	{
+		const float distance = cameraNormal.x * (node.bounds[0] - cameraPosition.x) + cameraNormal.y * (node.bounds[1] - cameraPosition.y) + cameraNormal.z * (node.bounds[2] - cameraPosition.z);
+		const float radius = node.bounds[3] * cameraNormal.Magnitude();
+		nearest = distance - radius;
+		farthest = distance + radius;
+	}
+	else
+	{
+		// the corners of the box with the lowest and the highest signed distance from the camera plane
+		nearest = 0;
+		farthest = 0;
+		const float normal[3] = { cameraNormal.x, cameraNormal.y, cameraNormal.z };
+		const float position[3] = { cameraPosition.x, cameraPosition.y, cameraPosition.z };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float low = normal[axis] * (node.bounds[axis] - position[axis]);
+			const float high = normal[axis] * (node.bounds[axis + 3] - position[axis]);
+			nearest += std::min(low, high);
+			farthest += std::max(low, high);
+		}
+	}
+
+	if (farthest < -VISIBILITY_EPSILON)
+	{
+		return -1;
+	}
+	return nearest >= -VISIBILITY_EPSILON ? 1 : 0;
+}
+
+bool BVHImage::isTriangleVisible(const uint32_t triangle, const Tuple3f& cameraPosition, const Vector3f& cameraNormal) const
+{
+	for (int i = 0; i < 3; i++)
+	{
+		const float* vertex = vertices + static_cast<size_t>(indices[triangle * 3 + i]) * 3;
+		const float distance = cameraNormal.x * (cameraPosition.x - vertex[0]) + cameraNormal.y * (cameraPosition.y - vertex[1]) + cameraNormal.z * (cameraPosition.z - vertex[2]);
+		if (distance <= VISIBILITY_EPSILON)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void BVHImage::pvs(const Tuple3f& cameraPosition, const Vector3f& cameraNormal, vector<uint32_t>& visible, int& testedTriangles) const
+{
+	visible.clear();
+	if (!isValid())
+	{
+		return;
+	}
+
+	vector<uint32_t> stack;
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const BVHImageNode& node = nodes[stack.back()];
+		stack.pop_back();
+
+		const int visibility = classify(node, cameraPosition, cameraNormal);
+		if (visibility < 0)
+		{
+			continue;
+		}
+
+		const uint32_t* first = references + node.firstReference;
+		const uint32_t* last = first + node.referenceCount;
+		if (visibility > 0)
+		{
+			visible.insert(visible.end(), first, last);
+		}
+		else if (node.left == BVH_IMAGE_NO_CHILD && node.right == BVH_IMAGE_NO_CHILD)
+		{
+			for (const uint32_t* reference = first; reference != last; reference++)
+			{
+				testedTriangles++;
+				if (isTriangleVisible(*reference, cameraPosition, cameraNormal))
+				{
+					visible.push_back(*reference);
+				}
+			}
+		}
+		else
+		{
+			if (node.right != BVH_IMAGE_NO_CHILD)
+			{
+				stack.push_back(node.right);
+			}
+			if (node.left != BVH_IMAGE_NO_CHILD)
+			{
+				stack.push_back(node.left);
+			}
+		}
+	}
+
+	// the triangles crossing a split plane are referenced by several leaves
+	std::sort(visible.begin(), visible.end());
+	visible.erase(std::unique(visible.begin(), visible.end()), visible.end());
+}
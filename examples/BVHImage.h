@@ -0,0 +1,165 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BVH.h"
+#include "../core/MappedFile.h"
+#include "../vecmath/IndexedMesh.h"
+#include "../vecmath/Vector3f.h"
+
+/** The value of BVHImageNode::left and BVHImageNode::right meaning that the node has no such child. */
+static const uint32_t BVH_IMAGE_NO_CHILD = 0;
+
+/**
+* The node of the BVH image.
+* The node contains no pointers; the children are given by their indices in the node array
+* and the triangles by a range in the reference array, so the nodes can be used directly from a mapped file.
+*/
+struct BVHImageNode
+{
+	/**
+	* The bounds of the node.
+	* For axis aligned boxes: minimum x,y,z followed by maximum x,y,z.
+	* For spheres: center x,y,z followed by the radius (the last two values are zero).
+	*/
+	float bounds[6];
+	/** The index of the first triangle reference of the node. */
+	uint32_t firstReference;
+	/** The number of triangle references of the node (including the references of all leaves below it). */
+	uint32_t referenceCount;
+	/** The index of the left child (BVH_IMAGE_NO_CHILD if there is none; the root is never a child). */
+	uint32_t left;
+	/** The index of the right child (BVH_IMAGE_NO_CHILD if there is none). */
+	uint32_t right;
+};
+
+/**
+* The header of the BVH image.
+* All offsets are in bytes relative to the start of the image and all sections are aligned to 16 bytes.
+*/
+struct BVHImageHeader
+{
+	/** The identification of the format, always BVH_IMAGE_MAGIC. */
+	char magic[4];
+	/** The version of the format, always BVH_IMAGE_VERSION. */
+	uint32_t version;
+	/** The type of the bounding volumes. */
+	uint32_t volumeType;
+	/** The number of nodes; the root is the node 0. */
+	uint32_t nodeCount;
+	/** The number of triangle references; only the leaves own references. */
+	uint32_t referenceCount;
+	/** The number of triangles of the mesh. */
+	uint32_t triangleCount;
+	/** The number of unique vertices of the mesh. */
+	uint32_t vertexCount;
+	/** Reserved for future use, always zero. */
+	uint32_t reserved;
+	/** The offset of the BVHImageNode array. */
+	uint64_t nodesOffset;
+	/** The offset of the uint32 triangle reference array. */
+	uint64_t referencesOffset;
+	/** The offset of the float x,y,z vertex array. */
+	uint64_t verticesOffset;
+	/** The offset of the uint32 vertex index array (three indices per triangle). */
+	uint64_t indicesOffset;
+	/** The size of the whole image in bytes. */
+	uint64_t size;
+};
+
+/** The magic bytes identifying the BVH image. */
+static const char BVH_IMAGE_MAGIC[4] = { 'B', 'V', 'H', 'I' };
+/** The current version of the BVH image. */
+static const uint32_t BVH_IMAGE_VERSION = 1;
+
+/**
+* The read-only BVH that is used directly from a memory-mapped file without any deserialization.
+*
+* The image contains the tree in the pre-order together with the mesh, so a query process needs nothing else.
+* The leaves own consecutive ranges of the reference array and each inner node references the union of the ranges of its leaves.
+* Since the file is mapped read-only, several processes querying the same image share a single copy in the page cache.
+*/
+class BVHImage
+{
+
+private:
+
+	/** The mapped file. */
+	MappedFile file;
+	/** The header of the image (nullptr if the image is not valid). */
+	const BVHImageHeader* header = nullptr;
+	/** The nodes in the pre-order. */
+	const BVHImageNode* nodes = nullptr;
+	/** The triangle references. */
+	const uint32_t* references = nullptr;
+	/** The vertex coordinates. */
+	const float* vertices = nullptr;
+	/** The vertex indices. */
+	const uint32_t* indices = nullptr;
+
+public:
+
+	/** Maps and validates the image on the given path. */
+	BVHImage(const string& path);
+
+	/**
+	* Writes the given tree and its mesh into an image.
+	*
+	* @param path		The path to the created file.
+	* @param tree		The tree.
+	* @param mesh		The mesh owning the triangles referenced by the tree.
+	* @return			{@p true} if the image was written.
+	*/
+	static bool write(const string& path, const BVH* tree, const IndexedMesh& mesh);
+
+	/** Returns true if the image was mapped and is valid. */
+	bool isValid() const
+	{
+		return header != nullptr;
+	}
+
+	/** Returns the type of the bounding volumes. */
+	VolumeType getVolumeType() const
+	{
+		return static_cast<VolumeType>(header->volumeType);
+	}
+
+	/** Returns the number of nodes. */
+	uint32_t getNodeCount() const
+	{
+		return header->nodeCount;
+	}
+
+	/** Returns the number of triangles. */
+	uint32_t getTriangleCount() const
+	{
+		return header->triangleCount;
+	}
+
+	/** Returns the node with the given index. */
+	const BVHImageNode& getNode(uint32_t index) const
+	{
+		return nodes[index];
+	}
+
+	/**
+	* Finds all triangles having at least one vertex in the half-space defined by the camera plane (the same query as BVHExample::pvs).
+	*
+	* @param cameraPosition		The position of the camera.
+	* @param cameraNormal		The normal of the camera plane.
+	* @param visible			The indices of the visible triangles (sorted, without duplicates).
+	* @param testedTriangles	The number of triangles that were actually tested.
+	*/
+	void pvs(const Tuple3f& cameraPosition, const Vector3f& cameraNormal, vector<uint32_t>& visible, int& testedTriangles) const;
+
+private:
+
+	/** Checks that all sections, children, and references are within the image. */
+	bool validate() const;
+
+	/** Returns -1 if the node is not visible, 0 if it is partially visible, and 1 if it is fully visible. */
+	int classify(const BVHImageNode& node, const Tuple3f& cameraPosition, const Vector3f& cameraNormal) const;
+
+	/** Checks if the triangle with the given index has a visible vertex. */
+	bool isTriangleVisible(uint32_t triangle, const Tuple3f& cameraPosition, const Vector3f& cameraNormal) const;
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include "BVH.h"
+#include "WideBVH.h"
+#include <tuple>
+
+struct BVHBuildWork;
+
+/**
+ * The policies of the bounding volumes of a BVH.
+ * The construction and the traversal are templates on the policy (see BVHExample::constructRange() and BVHExample::pvs()),
+ * so the type of the volume is checked once per tree and the code for each node calls the functions of the policy directly.
+ * The runtime VolumeType of the tree only selects the instantiation.
+ *
+ * The functions working with the triangles take the work arrays of the builder (see BVHBuildWork) and are defined in BVHExample.cpp next to the algorithms they use;
+ * the classification of the children of a wide node is defined here, since WideBVH calls it.
+ */
+struct BoxVolume
+{
+	/** The type of the volume stored in the tree. */
+	static constexpr VolumeType TYPE = VolumeType::AxisAlignedBoundingBox;
+
+	/**
+	 * Sets the volume of the node to the box of the triangles in the given range of the work arrays, enlarged by the error bound of the work store.
+	 *
+	 * @param node		The node.
+	 * @param work		The work arrays of the builder.
+	 * @param first		The first triangle of the node in the work arrays.
+	 * @param last		The triangle after the last triangle of the node in the work arrays.
+	 */
+	static void bound(BVHNode& node, const BVHBuildWork& work, size_t first, size_t last);
+
+	/** Sets the volume of the leaf to the box of its triangles in the vertex store of the tree, e.g., after the vertices moved (see BVHExample::refit()). */
+	static void bound(BVHNode& leaf, const BVH& tree);
+
+	/** Returns the axis (0, 1, or 2) and the position of the plane cutting the triangles of the node. */
+	static tuple<int, float> split(const BVHNode& node, const BVHBuildWork& work, size_t first, size_t last);
+
+	/** Sets the volume of the node to the smallest box containing the boxes of the given nodes. */
+	static void merge(BVHNode& node, const BVHNode& left, const BVHNode& right)
+	{
+		const Tuple3f a = left.getMin(), b = left.getMax(), c = right.getMin(), d = right.getMax();
+		node.setBox(Tuple3f(std::min(a.x, c.x), std::min(a.y, c.y), std::min(a.z, c.z)), Tuple3f(std::max(b.x, d.x), std::max(b.y, d.y), std::max(b.z, d.z)));
+	}
+
+	/** Returns -1 if the node is not visible, 0 if it is partially visible, and 1 if it is fully visible. */
+	static int classify(const BVHNode& node, const Tuple3f& cameraPosition, const Vector3f& cameraNormal);
+
+	/** Classifies all children of the wide node in the same way as a single node (see WideBVH::classify()). */
+	template <int WIDTH>
+	static void classify(const WideBVHNode<WIDTH>& wide, const Tuple3f& cameraPosition, const Vector3f& cameraNormal, int result[WIDTH])
+	{
+		const float nx = cameraNormal.x;
+		const float ny = cameraNormal.y;
+		const float nz = cameraNormal.z;
+		const float epsilon = 0.000001f;
+		// the corners of the box farthest along and against the normal are the ends of the diagonal isBoxVisible() picks
+		for (int lane = 0; lane < WIDTH; lane++)
+		{
+			const float ax = nx >= 0 ? wide.maxX[lane] : wide.minX[lane];
+			const float ay = ny >= 0 ? wide.maxY[lane] : wide.minY[lane];
+			const float az = nz >= 0 ? wide.maxZ[lane] : wide.minZ[lane];
+			const float bx = nx >= 0 ? wide.minX[lane] : wide.maxX[lane];
+			const float by = ny >= 0 ? wide.minY[lane] : wide.maxY[lane];
+			const float bz = nz >= 0 ? wide.minZ[lane] : wide.maxZ[lane];
+			const float a = nx * (cameraPosition.x - ax) + ny * (cameraPosition.y - ay) + nz * (cameraPosition.z - az);
+			const float b = nx * (cameraPosition.x - bx) + ny * (cameraPosition.y - by) + nz * (cameraPosition.z - bz);
+			result[lane] = -1 + (a <= epsilon) + (b <= epsilon);
+		}
+	}
+};
+
+/** The policy of the bounding spheres (see BoxVolume). */
+struct SphereVolume
+{
+	/** The type of the volume stored in the tree. */
+	static constexpr VolumeType TYPE = VolumeType::Sphere;
+
+	/** Sets the volume of the node to the sphere of the given triangles (see BoxVolume::bound()). */
+	static void bound(BVHNode& node, const BVHBuildWork& work, size_t first, size_t last);
+
+	/** Sets the volume of the leaf to the sphere of its triangles (see BoxVolume::bound()). */
+	static void bound(BVHNode& leaf, const BVH& tree);
+
+	/** Returns the axis (0, 1, or 2) and the position of the plane cutting the triangles of the node. */
+	static tuple<int, float> split(const BVHNode& node, const BVHBuildWork& work, size_t first, size_t last);
+
+	/** Sets the volume of the node to the smallest sphere containing the spheres of the given nodes. */
+	static void merge(BVHNode& node, const BVHNode& left, const BVHNode& right)
+	{
+		const Tuple3f a = left.getCenter(), b = right.getCenter();
+		const Tuple3f offset(b.x - a.x, b.y - a.y, b.z - a.z);
+		const float distance = std::sqrt(offset.x * offset.x + offset.y * offset.y + offset.z * offset.z);
+		if (distance + right.getRadius() <= left.getRadius())
+		{
+			node.setSphere(a, left.getRadius());
+			return;
+		}
+		if (distance + left.getRadius() <= right.getRadius())
+		{
+			node.setSphere(b, right.getRadius());
+			return;
+		}
+		// the sphere spans from the far side of the left sphere to the far side of the right one
+		const float radius = (distance + left.getRadius() + right.getRadius()) / 2;
+		const float t = (radius - left.getRadius()) / distance;
+		node.setSphere(Tuple3f(a.x + offset.x * t, a.y + offset.y * t, a.z + offset.z * t), radius);
+	}
+
+	/** Returns -1 if the node is not visible, 0 if it is partially visible, and 1 if it is fully visible. */
+	static int classify(const BVHNode& node, const Tuple3f& cameraPosition, const Vector3f& cameraNormal);
+
+	/** Classifies all children of the wide node in the same way as a single node (see WideBVH::classify()). */
+	template <int WIDTH>
+	static void classify(const WideBVHNode<WIDTH>& wide, const Tuple3f& cameraPosition, const Vector3f& cameraNormal, int result[WIDTH])
+	{
+		const float nx = cameraNormal.x;
+		const float ny = cameraNormal.y;
+		const float nz = cameraNormal.z;
+		const float epsilon = 0.000001f;
+		// the center is tested first and then the point moved by the normal towards the other side (see isSphereVisible())
+		for (int lane = 0; lane < WIDTH; lane++)
+		{
+			const float cx = wide.minX[lane];
+			const float cy = wide.minY[lane];
+			const float cz = wide.minZ[lane];
+			const bool center = nx * (cameraPosition.x - cx) + ny * (cameraPosition.y - cy) + nz * (cameraPosition.z - cz) <= epsilon;
+			const float sign = center ? -1.f : 1.f;
+			const float px = cx + sign * nx;
+			const float py = cy + sign * ny;
+			const float pz = cz + sign * nz;
+			const bool moved = nx * (cameraPosition.x - px) + ny * (cameraPosition.y - py) + nz * (cameraPosition.z - pz) <= epsilon;
+			result[lane] = (center ? 0 : -1) + moved;
+		}
+	}
+};
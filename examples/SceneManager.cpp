@@ -0,0 +1,219 @@
+#include "SceneManager.h"
+#include "../core/ModelLoader.h"
+#include <algorithm>
+#include <filesystem>
+
+const string SceneManager::DIRECTORY = "models";
+
+/** Returns the estimated number of bytes occupied by the given models. */
+static size_t totalBytes(const list<SceneModel*>& models)
+{
+	size_t bytes = 0;
+	for (const SceneModel* model : models)
+	{
+		bytes += model->memoryBytes();
+	}
+	return bytes;
+}
+
+SceneModel::~SceneModel()
+{
+	delete root;
+}
+
+size_t SceneModel::memoryBytes() const
+{
+	const size_t tree = root != nullptr ? root->memoryBytes() : 0;
+	return sizeof(SceneModel) + mesh.memoryBytes() + quantizedMesh.memoryBytes() + geometry.capacity() * sizeof(Triangle*) + tree;
+}
+
+SceneManager::~SceneManager()
+{
+	for (SceneModel* model : models)
+	{
+		delete model;
+	}
+}
+
+SceneModel* SceneManager::load(const string& path)
+{
+	MeshData data;
+	LoadStats stats;
+	if (!ModelLoader::load(path, data, stats))
+	{
+		cout << "WARNING: the file " << path << " could not be opened." << endl;
+		return nullptr;
+	}
+	if (data.triangleCount() == 0)
+	{
+		cout << "WARNING: the file " << path << " contains no triangles." << endl;
+		return nullptr;
+	}
+
+	if (data.vertices.size() % 9 != 0)
+	{
+		cout << "WARNING: some vertices are missing.";
+	}
+
+	cout << "Loaded " << path << " (" << stats.format << "): " << data.triangleCount() << " triangles, " << stats.bytes / (1024.0 * 1024.0) << " MB parsed in "
+		<< stats.parseSeconds * 1000 << " ms (" << stats.throughput() << " MB/s), " << stats.totalSeconds * 1000 << " ms in total." << endl;
+
+	SceneModel* model = new SceneModel(path);
+	model->mesh.build(data.vertices.data(), data.triangleCount());
+	model->meshHash = BVHCache::hashMesh(model->mesh);
+
+	cout << "Welded " << data.triangleCount() * 3 << " vertices into " << model->mesh.vertexCount() << " unique vertices, "
+		<< model->mesh.memoryBytes() / 1024 << " KB in the mesh." << endl;
+
+	model->geometry.reserve(model->mesh.triangleCount());
+	for (Triangle& triangle : model->mesh.triangles)
+	{
+		model->geometry.push_back(&triangle);
+	}
+	return model;
+}
+
+SceneModel* SceneManager::acquire(const string& path)
+{
+	const auto findModel = [this, &path]()
+	{
+		return find_if(models.begin(), models.end(), [&path](const SceneModel* model) { return model->path == path; });
+	};
+
+	{
+		lock_guard<mutex> lock(sceneMutex);
+		auto found = findModel();
+		if (found != models.end())
+		{
+			models.splice(models.begin(), models, found);
+			active = models.front();
+			evict();
+			return active;
+		}
+	}
+
+	// the file is loaded without the lock, so the window can still ask the scene for its memory every frame
+	SceneModel* model = load(path);
+	if (model == nullptr)
+	{
+		return nullptr;
+	}
+
+	lock_guard<mutex> lock(sceneMutex);
+	// another thread may have loaded the same file meanwhile; its model is kept, since it may already be in use
+	auto found = findModel();
+	if (found != models.end())
+	{
+		delete model;
+		models.splice(models.begin(), models, found);
+	}
+	else
+	{
+		models.push_front(model);
+	}
+
+	active = models.front();
+	evict();
+	return active;
+}
+
+void SceneManager::setTree(SceneModel* model, BVH* tree, const BVHCacheKey& key)
+{
+	lock_guard<mutex> lock(sceneMutex);
+
+	if (model->root != tree)
+	{
+		delete model->root;
+		model->root = tree;
+	}
+	model->treeKey = key;
+	evict();
+}
+
+void SceneManager::setQuantizedVertices(SceneModel* model, const bool quantized)
+{
+	// only the thread building the trees of the model changes its quantized vertices, so it reads them without the lock
+	if (quantized != model->quantizedMesh.isEmpty())
+	{
+		return;
+	}
+
+	QuantizedMesh quantizedMesh;
+	if (quantized)
+	{
+		quantizedMesh.build(model->mesh);
+		cout << "Quantized vertices: " << quantizedMesh.memoryBytes() / 1024 << " KB instead of " << model->mesh.vertexCount() * sizeof(Tuple3f) / 1024
+			<< " KB, error bound " << quantizedMesh.getErrorBound() << "." << endl;
+	}
+
+	lock_guard<mutex> lock(sceneMutex);
+	// the empty mesh releases the quantized vertices
+	model->quantizedMesh = move(quantizedMesh);
+	evict();
+}
+
+void SceneManager::evict()
+{
+	size_t bytes = totalBytes(models);
+	auto model = models.end();
+	while (bytes > budget && model != models.begin())
+	{
+		model--;
+		if (*model == active)
+		{
+			continue;
+		}
+
+		const size_t modelBytes = (*model)->memoryBytes();
+		cout << "Evicted " << (*model)->path << " from the scene (" << modelBytes / 1024 << " KB)." << endl;
+		bytes -= modelBytes;
+		delete *model;
+		model = models.erase(model);
+	}
+
+	if (bytes > budget)
+	{
+		cout << "WARNING: the active model needs " << bytes / 1024 << " KB, which is more than the scene budget of " << budget / 1024 << " KB." << endl;
+	}
+}
+
+void SceneManager::setBudget(const size_t budget)
+{
+	lock_guard<mutex> lock(sceneMutex);
+	this->budget = budget;
+	evict();
+}
+
+size_t SceneManager::getBudget() const
+{
+	lock_guard<mutex> lock(sceneMutex);
+	return budget;
+}
+
+size_t SceneManager::memoryBytes() const
+{
+	lock_guard<mutex> lock(sceneMutex);
+	return totalBytes(models);
+}
+
+size_t SceneManager::modelCount() const
+{
+	lock_guard<mutex> lock(sceneMutex);
+	return models.size();
+}
+
+vector<string> SceneManager::listModels(const string& directory)
+{
+	vector<string> paths;
+	error_code error;
+	for (const auto& entry : filesystem::directory_iterator(directory, error))
+	{
+		const string extension = entry.path().extension().string();
+		if (entry.is_regular_file() && (extension == ".raw" || extension == ".stl" || extension == ".ply" || extension == ".obj"))
+		{
+			paths.push_back(entry.path().generic_string());
+		}
+	}
+	sort(paths.begin(), paths.end());
+	return paths;
+}
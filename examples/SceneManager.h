@@ -0,0 +1,146 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "BVH.h"
+#include "BVHCache.h"
+#include "../vecmath/IndexedMesh.h"
+#include "../vecmath/QuantizedMesh.h"
+
+/** A model held by the SceneManager: its triangle store and the tree constructed over it. */
+class SceneModel
+{
+
+public:
+
+	/** The path to the model file. */
+	string path;
+	/** The welded mesh owning the vertices and triangles of the model. */
+	IndexedMesh mesh;
+	/** The 16-bit quantized vertices of the mesh; they are built only while the trees are built from them (see SceneManager::setQuantizedVertices()). */
+	QuantizedMesh quantizedMesh;
+	/** All triangles of the mesh in the order of the mesh. */
+	vector<Triangle*> geometry;
+	/** The hash of the mesh identifying its trees in the cache. */
+	uint64_t meshHash = 0;
+	/** The final tree of the model (nullptr if none was built yet); the tree is owned by the model. */
+	BVH* root = nullptr;
+	/** The key the tree was built with. */
+	BVHCacheKey treeKey;
+
+public:
+
+	/** Constructs an empty model of the given file. */
+	SceneModel(const string& path) : path(path)
+	{
+	}
+
+	/** Releases the tree of the model. */
+	~SceneModel();
+
+	// The mesh must not be copied (see IndexedMesh).
+	SceneModel(const SceneModel&) = delete;
+	SceneModel& operator=(const SceneModel&) = delete;
+
+	/** Returns true if the model holds a tree built with the given key. */
+	bool hasTree(const BVHCacheKey& key) const
+	{
+		return root != nullptr && treeKey.hash() == key.hash();
+	}
+
+	/** Returns the estimated number of bytes occupied by the mesh, the geometry, and the tree. */
+	size_t memoryBytes() const;
+};
+
+/**
+* The SceneManager holds several models at once, each with its own triangle store and tree.
+*
+* The models are kept in the order of their last use. Whenever the estimated memory of all models exceeds the budget,
+* the least recently used models are evicted (their triangles and trees are released) until the budget is met again.
+* The active model, i.e., the model returned by the last call of acquire(), is never evicted, since the viewer and the worker use it.
+* The methods are thread-safe.
+*/
+class SceneManager
+{
+
+public:
+
+	/** The directory with the models that can be displayed. */
+	static const string DIRECTORY;
+
+	/** The memory budget of the new scenes in bytes (set by the --scene-budget option); the least recently used models are evicted when it is exceeded. */
+	inline static size_t defaultBudget = 256 * 1024 * 1024;
+
+private:
+
+	/** The memory budget in bytes. */
+	size_t budget;
+	/** The loaded models, the most recently used first. */
+	list<SceneModel*> models;
+	/** The model returned by the last call of acquire(). */
+	SceneModel* active = nullptr;
+	/** Guards the models. */
+	mutable mutex sceneMutex;
+
+public:
+
+	/** Constructs an empty scene with the given memory budget in bytes. */
+	SceneManager(size_t budget = defaultBudget) : budget(budget)
+	{
+	}
+
+	/** Releases all models. */
+	~SceneManager();
+
+	// The models are owned by the scene.
+	SceneManager(const SceneManager&) = delete;
+	SceneManager& operator=(const SceneManager&) = delete;
+
+	/**
+	* Returns the model on the given path, loading it if it is not held by the scene yet.
+	* The model becomes the active (and the most recently used) model and the least recently used models are evicted if needed.
+	* The file is loaded without holding the lock of the scene, so the other methods do not wait for the load.
+	*
+	* @param path		The path to the model file.
+	* @return			The model or {@p nullptr} if the file could not be loaded.
+	*/
+	SceneModel* acquire(const string& path);
+
+	/**
+	* Replaces the tree of the given model; the previous tree of the model is deleted.
+	* The least recently used models are evicted if the new tree exceeds the budget.
+	*/
+	void setTree(SceneModel* model, BVH* tree, const BVHCacheKey& key);
+
+	/**
+	* Builds the quantized vertices of the given model if the trees are going to be built from them and releases them otherwise,
+	* so only the models built with the 16-bit vertices pay for them. The vertices are quantized without holding the lock of the scene;
+	* the least recently used models are evicted if they exceed the budget. It must be called by the thread building the trees of the model.
+	*/
+	void setQuantizedVertices(SceneModel* model, bool quantized);
+
+	/** Sets the memory budget in bytes and evicts the models that no longer fit. */
+	void setBudget(size_t budget);
+
+	/** Returns the memory budget in bytes. */
+	size_t getBudget() const;
+
+	/** Returns the estimated number of bytes occupied by all models. */
+	size_t memoryBytes() const;
+
+	/** Returns the number of models held by the scene. */
+	size_t modelCount() const;
+
+	/** Returns the sorted paths of all model files (*.raw, *.stl, *.ply, *.obj) in the given directory. */
+	static vector<string> listModels(const string& directory = DIRECTORY);
+
+private:
+
+	/** Loads the model on the given path; returns nullptr if the file could not be loaded. */
+	static SceneModel* load(const string& path);
+
+	/** Evicts the least recently used models (except the active one) until the budget is met; the mutex must be locked. */
+	void evict();
+};
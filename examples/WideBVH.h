@@ -0,0 +1,157 @@
+#pragma once
+#include "BVH.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * A node of the WideBVH with up to WIDTH children.
+ * The bounds of the children are stored as a structure of arrays, so all children are classified against the camera plane
+ * by a single loop over the lanes, which the compiler turns into vector instructions (4 lanes with SSE, 8 with AVX).
+ */
+template <int WIDTH>
+struct alignas(64) WideBVHNode
+{
+	/** The minimum points of the child boxes, or the centers of the child spheres. */
+	float minX[WIDTH], minY[WIDTH], minZ[WIDTH];
+	/** The maximum points of the child boxes; the radii of the child spheres are stored in maxX. */
+	float maxX[WIDTH], maxY[WIDTH], maxZ[WIDTH];
+	/** The wide node of each inner child, or BVH_NO_NODE for the leaves. */
+	uint32_t child[WIDTH];
+	/** The node of the binary tree each child was collapsed from; it identifies the triangles and the volume of the child. */
+	uint32_t binary[WIDTH];
+	/** The number of children. */
+	uint32_t count;
+};
+
+/**
+ * The WIDTH-ary tree collapsed from a binary BVH, e.g., BVH4 or BVH8.
+ * Each wide node replaces several levels of the binary tree: the children of an inner binary node are repeatedly replaced by their own children
+ * (the child with the most triangles first) until WIDTH children are collected, so the traversal needs fewer and wider steps.
+ * The leaves are the leaves of the binary tree, so the triangle references and their vertices are taken from it; the binary tree must outlive the wide tree.
+ * The root node has the root of the binary tree as its only child, so the root volume is tested like in the binary tree.
+ */
+template <int WIDTH>
+class WideBVH
+{
+
+public:
+
+	/** The index of the root node. */
+	static constexpr uint32_t ROOT = 0;
+
+	/** The binary tree the wide tree was collapsed from. */
+	const BVH& source;
+	/** The nodes in the depth-first pre-order. */
+	vector<WideBVHNode<WIDTH>> nodes;
+
+	/** Collapses the given binary tree. */
+	WideBVH(const BVH& source) : source(source)
+	{
+		nodes.reserve(source.size() / (WIDTH / 2) + 1);
+		collapse(vector<uint32_t>(1, BVH::ROOT));
+	}
+
+	// The nodes refer to the binary tree.
+	WideBVH(const WideBVH&) = delete;
+	WideBVH& operator=(const WideBVH&) = delete;
+
+	/** Returns the given node. */
+	const WideBVHNode<WIDTH>& operator[](uint32_t node) const
+	{
+		return nodes[node];
+	}
+
+	/** Returns the number of bytes occupied by the nodes. */
+	size_t memoryBytes() const
+	{
+		return sizeof(WideBVH) + nodes.capacity() * sizeof(WideBVHNode<WIDTH>);
+	}
+
+	/**
+	 * Classifies all children of the given node against the camera plane in the same way as isBoxVisible() and isSphereVisible() classify a single node.
+	 * The volume policy (BoxVolume or SphereVolume) must match the volume type of the binary tree.
+	 *
+	 * @param node				The node.
+	 * @param cameraPosition	The position of the camera.
+	 * @param cameraNormal		The normal of the camera plane.
+	 * @param result			Receives -1 for each invisible child, 0 for each partially visible child, and 1 for each fully visible child.
+	 */
+	template <class Volume>
+	void classify(uint32_t node, const Tuple3f& cameraPosition, const Vector3f& cameraNormal, int result[WIDTH]) const
+	{
+		Volume::template classify<WIDTH>(nodes[node], cameraPosition, cameraNormal, result);
+	}
+
+private:
+
+	/** Returns the number of triangle references of the given binary node. */
+	size_t triangleCount(uint32_t node) const
+	{
+		return source.getTriangles(node).size();
+	}
+
+	/**
+	 * Appends the wide node with the given children of the binary tree and collapses the subtrees of its inner children after it.
+	 * Returns the index of the appended node.
+	 */
+	uint32_t collapse(vector<uint32_t> children)
+	{
+		const uint32_t index = static_cast<uint32_t>(nodes.size());
+		nodes.push_back(WideBVHNode<WIDTH>());
+		WideBVHNode<WIDTH> node = {};
+		node.count = static_cast<uint32_t>(children.size());
+		for (size_t lane = 0; lane < children.size(); lane++)
+		{
+			const BVHNode& child = source[children[lane]];
+			node.minX[lane] = child.bounds[0];
+			node.minY[lane] = child.bounds[1];
+			node.minZ[lane] = child.bounds[2];
+			node.maxX[lane] = child.bounds[3];
+			node.maxY[lane] = child.bounds[4];
+			node.maxZ[lane] = child.bounds[5];
+			node.binary[lane] = children[lane];
+			node.child[lane] = BVH_NO_NODE;
+		}
+		for (size_t lane = children.size(); lane < WIDTH; lane++)
+		{
+			node.child[lane] = BVH_NO_NODE;
+			node.binary[lane] = BVH_NO_NODE;
+		}
+
+		for (size_t lane = 0; lane < children.size(); lane++)
+		{
+			if (!source[children[lane]].isLeaf())
+			{
+				node.child[lane] = collapse(grandchildren(children[lane]));
+			}
+		}
+		nodes[index] = node;
+		return index;
+	}
+
+	/** Returns up to WIDTH descendants of the given inner binary node that together cover all its leaves, in the order of the leaves. */
+	vector<uint32_t> grandchildren(uint32_t node) const
+	{
+		vector<uint32_t> children = { source.getLeft(node), source.getRight(node) };
+		while (children.size() < WIDTH)
+		{
+			// the inner child with the most triangles is opened first, since it is the most likely to be partially visible
+			size_t best = children.size();
+			for (size_t i = 0; i < children.size(); i++)
+			{
+				if (!source[children[i]].isLeaf() && (best == children.size() || triangleCount(children[i]) > triangleCount(children[best])))
+				{
+					best = i;
+				}
+			}
+			if (best == children.size())
+			{
+				break;
+			}
+			const uint32_t opened = children[best];
+			children[best] = source.getRight(opened);
+			children.insert(children.begin() + best, source.getLeft(opened));
+		}
+		return children;
+	}
+};
@@ -0,0 +1,84 @@
+#include "IndexedMesh.h"
+#include <cstring>
+
+/** Marks an empty slot of the welding table. */
+static const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+/** Returns the bit pattern of the given coordinate; both zeros share the same pattern since they compare equal. */
+static inline uint32_t coordinateBits(float value)
+{
+	if (value == 0.f)
+	{
+		value = 0.f;
+	}
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+/** Computes the hash of the given position (the finalizer of MurmurHash3 applied to the mixed coordinates). */
+static inline uint64_t hashPosition(const float x, const float y, const float z)
+{
+	uint64_t h = (static_cast<uint64_t>(coordinateBits(x)) << 32 | coordinateBits(y)) ^ (static_cast<uint64_t>(coordinateBits(z)) * 0x9E3779B97F4A7C15ull);
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+void IndexedMesh::build(const float* soup, const size_t triangleCount)
+{
+	clear();
+
+	// open addressing table with linear probing; at most half full, so the probe sequences stay short
+	size_t tableSize = 16;
+	while (tableSize < triangleCount * 3 * 2)
+	{
+		tableSize *= 2;
+	}
+	const size_t mask = tableSize - 1;
+	vector<uint32_t> table(tableSize, EMPTY_SLOT);
+
+	indices.resize(triangleCount * 3);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		const float x = soup[i * 3];
+		const float y = soup[i * 3 + 1];
+		const float z = soup[i * 3 + 2];
+
+		size_t slot = hashPosition(x, y, z) & mask;
+		while (table[slot] != EMPTY_SLOT)
+		{
+			const Tuple3f& existing = vertices[table[slot]];
+			if (existing.x == x && existing.y == y && existing.z == z)
+			{
+				break;
+			}
+			slot = (slot + 1) & mask;
+		}
+
+		if (table[slot] == EMPTY_SLOT)
+		{
+			table[slot] = static_cast<uint32_t>(vertices.size());
+			vertices.emplace_back(x, y, z);
+		}
+		indices[i] = table[slot];
+	}
+	vertices.shrink_to_fit();
+
+	// the vertex array is final now, so the triangles can safely reference it
+	triangles.reserve(triangleCount);
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		triangles.emplace_back(vertices[indices[i * 3]], vertices[indices[i * 3 + 1]], vertices[indices[i * 3 + 2]]);
+	}
+}
+
+void IndexedMesh::clear()
+{
+	triangles.clear();
+	indices.clear();
+	vertices.clear();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Triangle.h"
+
+/**
+* The IndexedMesh stores each distinct vertex position only once.
+* The triangles are given by three indices into the vertex array.
+* Identical positions are welded together when the mesh is built, so a vertex shared by several triangles is stored once
+* and later stages (e.g., deformation) can work per unique vertex.
+*/
+class IndexedMesh
+{
+
+public:
+
+	/** The unique vertex positions. */
+	vector<Tuple3f> vertices;
+	/** The vertex indices, three per triangle. */
+	vector<uint32_t> indices;
+	/** The triangles referencing the vertex array; the i-th triangle is defined by indices 3i, 3i+1, and 3i+2. */
+	vector<Triangle> triangles;
+
+public:
+
+	/** Constructs an empty mesh. */
+	IndexedMesh() = default;
+
+	// The triangles reference the vertices of this mesh, so the mesh must not be copied.
+	IndexedMesh(const IndexedMesh&) = delete;
+	IndexedMesh& operator=(const IndexedMesh&) = delete;
+
+	/**
+	* Builds the mesh from the triangle soup, welding the vertices with identical positions.
+	*
+	* @param soup			The vertex coordinates, nine floats (three vertices) per triangle.
+	* @param triangleCount	The number of triangles in the soup.
+	*/
+	void build(const float* soup, size_t triangleCount);
+
+	/** Removes all vertices and triangles. */
+	void clear();
+
+	/** Returns the number of triangles. */
+	size_t triangleCount() const
+	{
+		return indices.size() / 3;
+	}
+
+	/** Returns the number of unique vertices. */
+	size_t vertexCount() const
+	{
+		return vertices.size();
+	}
+
+	/** Returns the index of the given triangle of this mesh. */
+	size_t indexOf(const Triangle* triangle) const
+	{
+		return static_cast<size_t>(triangle - triangles.data());
+	}
+
+	/** Returns the number of bytes occupied by the vertices, indices, and triangles. */
+	size_t memoryBytes() const
+	{
+		return vertices.capacity() * sizeof(Tuple3f) + indices.capacity() * sizeof(uint32_t) + triangles.capacity() * sizeof(Triangle);
+	}
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include "Tuple3f.h"
+
+/**
+* The Morton codes interleave the bits of the quantized coordinates of a point (x in the lowest bit), so the points sorted by their codes
+* follow the Z-order curve and the points sharing a prefix of their codes lie in the same octree cell.
+* The points are expected in the [-1,1] cube of the normalized models (see ModelLoader::normalize()); the points outside it are clamped.
+*/
+
+/** Spreads the lower 10 bits of the value so there are two zero bits between each two of them. */
+constexpr uint32_t expandMortonBits(uint32_t value)
+{
+	value &= 0x3FFu;
+	value = (value | (value << 16)) & 0x030000FFu;
+	value = (value | (value << 8)) & 0x0300F00Fu;
+	value = (value | (value << 4)) & 0x030C30C3u;
+	value = (value | (value << 2)) & 0x09249249u;
+	return value;
+}
+
+/** Spreads the lower 21 bits of the value so there are two zero bits between each two of them. */
+constexpr uint64_t expandMortonBits(uint64_t value)
+{
+	value &= 0x1FFFFFull;
+	value = (value | (value << 32)) & 0x001F00000000FFFFull;
+	value = (value | (value << 16)) & 0x001F0000FF0000FFull;
+	value = (value | (value << 8)) & 0x100F00F00F00F00Full;
+	value = (value | (value << 4)) & 0x10C30C30C30C30C3ull;
+	value = (value | (value << 2)) & 0x1249249249249249ull;
+	return value;
+}
+
+/**
+* Returns the Morton code of the point in the [-1,1] cube: 30 bits (10 per axis) for uint32_t codes and 63 bits (21 per axis) for uint64_t codes.
+*/
+template <typename Code>
+Code mortonCode(const Tuple3f& point)
+{
+	constexpr int BITS = sizeof(Code) == 4 ? 10 : 21;
+	constexpr float CELLS = static_cast<float>(1u << BITS);
+	const auto quantize = [](float coordinate)
+	{
+		const float cell = (coordinate + 1.f) * 0.5f * CELLS;
+		return static_cast<Code>(std::min(std::max(cell, 0.f), CELLS - 1));
+	};
+	return expandMortonBits(quantize(point.x)) | (expandMortonBits(quantize(point.y)) << 1) | (expandMortonBits(quantize(point.z)) << 2);
+}
+
+/** The number of bits of the Morton codes of the given type. */
+template <typename Code>
+constexpr int MORTON_BITS = sizeof(Code) == 4 ? 30 : 63;
@@ -0,0 +1,46 @@
+#include "QuantizedMesh.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void QuantizedMesh::build(const IndexedMesh& mesh)
+{
+	Tuple3f min(numeric_limits<float>::max(), numeric_limits<float>::max(), numeric_limits<float>::max());
+	Tuple3f max(numeric_limits<float>::lowest(), numeric_limits<float>::lowest(), numeric_limits<float>::lowest());
+	for (const Tuple3f& vertex : mesh.vertices)
+	{
+		min = Tuple3f(std::min(min.x, vertex.x), std::min(min.y, vertex.y), std::min(min.z, vertex.z));
+		max = Tuple3f(std::max(max.x, vertex.x), std::max(max.y, vertex.y), std::max(max.z, vertex.z));
+	}
+	if (mesh.vertices.empty())
+	{
+		min = max = Tuple3f();
+	}
+
+	origin = min;
+	step = (max - min) / LEVELS;
+	indices = &mesh.indices;
+
+	coordinates.resize(mesh.vertices.size() * 3);
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		coordinates[i * 3] = quantize(mesh.vertices[i].x, origin.x, step.x);
+		coordinates[i * 3 + 1] = quantize(mesh.vertices[i].y, origin.y, step.y);
+		coordinates[i * 3 + 2] = quantize(mesh.vertices[i].z, origin.z, step.z);
+	}
+
+	// the bound is measured instead of derived from the step, so it also covers the rounding of the dequantization
+	errorBound = Tuple3f();
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const Tuple3f error = getVertex(static_cast<uint32_t>(i)) - mesh.vertices[i];
+		errorBound = Tuple3f(std::max(errorBound.x, std::abs(error.x)), std::max(errorBound.y, std::abs(error.y)), std::max(errorBound.z, std::abs(error.z)));
+	}
+}
+
+void QuantizedMesh::clear()
+{
+	coordinates.clear();
+	coordinates.shrink_to_fit();
+	indices = nullptr;
+}
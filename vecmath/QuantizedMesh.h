@@ -0,0 +1,94 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "IndexedMesh.h"
+
+/**
+* The QuantizedMesh stores the unique vertices of an IndexedMesh as 16-bit fixed-point numbers, which halves the vertex memory.
+* The coordinates are quantized relative to the bounding box of the mesh, which is the [-1,1] cube for the normalized models.
+* The largest difference between a vertex and its dequantized value is measured when the mesh is built and available through
+* getErrorBound(), so the bounds and visibility tests can be made conservative.
+*/
+class QuantizedMesh
+{
+
+private:
+
+	/** The quantized coordinates, three per vertex. */
+	vector<uint16_t> coordinates;
+	/** The vertex indices of the triangles (shared with the source mesh). */
+	const vector<uint32_t>* indices = nullptr;
+	/** The minimum corner of the quantized range. */
+	Tuple3f origin;
+	/** The size of a single quantization step in each axis. */
+	Tuple3f step;
+	/** The largest difference between a vertex and its dequantized value in each axis. */
+	Tuple3f errorBound;
+
+public:
+
+	/** The largest quantized value. */
+	static constexpr float LEVELS = 65535.f;
+
+	/** Quantizes the given coordinate to the number of steps from the origin (clamped to the 16-bit range). */
+	static uint16_t quantize(float value, float origin, float step)
+	{
+		if (step <= 0)
+		{
+			return 0;
+		}
+		const float q = std::round((value - origin) / step);
+		return static_cast<uint16_t>(std::min(std::max(q, 0.f), LEVELS));
+	}
+
+	/** Quantizes the vertices of the given mesh; the mesh must outlive this object since its indices are shared. */
+	void build(const IndexedMesh& mesh);
+
+	/** Removes all vertices. */
+	void clear();
+
+	/** Returns true if the mesh was built. */
+	bool isEmpty() const
+	{
+		return indices == nullptr;
+	}
+
+	/** Returns the dequantized vertex with the given index. */
+	Tuple3f getVertex(uint32_t vertex) const
+	{
+		const uint16_t* q = &coordinates[static_cast<size_t>(vertex) * 3];
+		return Tuple3f(origin.x + q[0] * step.x, origin.y + q[1] * step.y, origin.z + q[2] * step.z);
+	}
+
+	/** Returns the dequantized i-th (0-2) vertex of the given triangle. */
+	Tuple3f getVertex(size_t triangle, int i) const
+	{
+		return getVertex((*indices)[triangle * 3 + i]);
+	}
+
+	/** Returns the minimum corner of the quantized range. */
+	const Tuple3f& getOrigin() const
+	{
+		return origin;
+	}
+
+	/** Returns the size of a single quantization step in each axis. */
+	const Tuple3f& getStep() const
+	{
+		return step;
+	}
+
+	/** Returns the largest difference between a vertex and its dequantized value in each axis. */
+	const Tuple3f& getErrorBound() const
+	{
+		return errorBound;
+	}
+
+	/** Returns the number of bytes occupied by the quantized vertices. */
+	size_t memoryBytes() const
+	{
+		return coordinates.capacity() * sizeof(uint16_t);
+	}
+};
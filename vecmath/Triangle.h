@@ -5,6 +5,8 @@
 
 /**
 * The Triangle describes a triangle in 3D Cartesian space defined by a three points.
+* The triangle references its points (usually stored in the vertex array of IndexedMesh) instead of copying them,
+* so the points must outlive the triangle.
 *
 * @author <a href="mailto:jan.byska@gmail.com">Jan Byka</a>
 */
@@ -12,18 +14,18 @@ class Triangle
 {
 public:
 	/** The first point. */
-	Tuple3f v1;
+	const Tuple3f& v1;
 	/** The second point. */
-	Tuple3f v2;
+	const Tuple3f& v2;
 	/** The third point. */
-	Tuple3f v3;
+	const Tuple3f& v3;
 
-	/** Constructs a new triangle.
+	/** Constructs a new triangle referencing the given points.
 	 * @param v1	The first point.
 	 * @param v2	The second point.
 	 * @param v3	The third point.
 	 */
-	Triangle(const Tuple3f v1, const Tuple3f v2, const Tuple3f v3) : v1(v1), v2(v2), v3(v3)
+	Triangle(const Tuple3f& v1, const Tuple3f& v2, const Tuple3f& v3) : v1(v1), v2(v2), v3(v3)
 	{
 	}
 
@@ -0,0 +1,501 @@
+#include "TriangleSoA.h"
+#include "QuantizedMesh.h"
+#include <algorithm>
+#include <cmath>
+
+/** Returns the given number of triangles rounded up to whole blocks. */
+static inline size_t padded(const size_t count)
+{
+	return (count + TriangleSoA::LANES - 1) / TriangleSoA::LANES * TriangleSoA::LANES;
+}
+
+TriangleSoA::TriangleSoA(MemoryArena* arena)
+{
+	for (auto& array : coordinates)
+	{
+		array = ArenaVector<float, ALIGNMENT>(ArenaAllocator<float, ALIGNMENT>(arena));
+	}
+	for (auto& array : quantizedCoordinates)
+	{
+		array = ArenaVector<uint16_t, ALIGNMENT>(ArenaAllocator<uint16_t, ALIGNMENT>(arena));
+	}
+	scratch = ArenaVector<float>(ArenaAllocator<float>(arena));
+}
+
+/** Resizes the array to the given number of triangles padded to whole blocks; the padding lanes are zero, so the kernels may read them. */
+template <typename Array>
+static void resizeArray(Array& array, const size_t count, const size_t size)
+{
+	// the arrays only grow (up to their capacity), since the work store of the builder shrinks and grows again for every node;
+	// the arrays outgrowing their arena move to the heap (see reserveGrowth())
+	if (array.size() < size)
+	{
+		reserveGrowth(array, size);
+		array.resize(array.capacity(), 0);
+	}
+	std::fill(array.begin() + count, array.begin() + size, 0);
+}
+
+void TriangleSoA::resize(const size_t count)
+{
+	const size_t size = padded(count);
+	for (int array = 0; array < 9; array++)
+	{
+		if (quantized)
+		{
+			resizeArray(quantizedCoordinates[array], count, size);
+		}
+		else
+		{
+			resizeArray(coordinates[array], count, size);
+		}
+	}
+	this->count = count;
+}
+
+void TriangleSoA::reserve(const size_t count)
+{
+	for (int array = 0; array < 9; array++)
+	{
+		if (quantized)
+		{
+			quantizedCoordinates[array].reserve(padded(count));
+		}
+		else
+		{
+			coordinates[array].reserve(padded(count));
+		}
+	}
+}
+
+void TriangleSoA::clear()
+{
+	for (auto& array : coordinates)
+	{
+		array.clear();
+		array.shrink_to_fit();
+	}
+	for (auto& array : quantizedCoordinates)
+	{
+		array.clear();
+		array.shrink_to_fit();
+	}
+	quantized = false;
+	scratch.clear();
+	scratch.shrink_to_fit();
+	count = 0;
+	errorBound = Tuple3f();
+}
+
+void TriangleSoA::set(const size_t i, const Tuple3f& v1, const Tuple3f& v2, const Tuple3f& v3)
+{
+	const Tuple3f* vertices[3] = { &v1, &v2, &v3 };
+	if (quantized)
+	{
+		for (int vertex = 0; vertex < 3; vertex++)
+		{
+			quantizedCoordinates[vertex * 3][i] = QuantizedMesh::quantize(vertices[vertex]->x, origin[0], step[0]);
+			quantizedCoordinates[vertex * 3 + 1][i] = QuantizedMesh::quantize(vertices[vertex]->y, origin[1], step[1]);
+			quantizedCoordinates[vertex * 3 + 2][i] = QuantizedMesh::quantize(vertices[vertex]->z, origin[2], step[2]);
+		}
+		return;
+	}
+	for (int vertex = 0; vertex < 3; vertex++)
+	{
+		coordinates[vertex * 3][i] = vertices[vertex]->x;
+		coordinates[vertex * 3 + 1][i] = vertices[vertex]->y;
+		coordinates[vertex * 3 + 2][i] = vertices[vertex]->z;
+	}
+}
+
+void TriangleSoA::copy(const TriangleSoA& source, const size_t first, const size_t count, const size_t to)
+{
+	for (int array = 0; array < 9; array++)
+	{
+		const int axis = array % 3;
+		if (quantized && source.quantized)
+		{
+			std::copy_n(source.quantizedCoordinates[array].begin() + first, count, quantizedCoordinates[array].begin() + to);
+		}
+		else if (quantized)
+		{
+			// the dequantized vertices of the grid round back to their steps exactly
+			const float* values = source.coordinates[array].data() + first;
+			uint16_t* steps = quantizedCoordinates[array].data() + to;
+			for (size_t i = 0; i < count; i++)
+			{
+				steps[i] = QuantizedMesh::quantize(values[i], origin[axis], step[axis]);
+			}
+		}
+		else if (source.quantized)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				coordinates[array][to + i] = source.coordinate(array, first + i);
+			}
+		}
+		else
+		{
+			std::copy_n(source.coordinates[array].begin() + first, count, coordinates[array].begin() + to);
+		}
+	}
+}
+
+void TriangleSoA::setQuantization(const Tuple3f& origin, const Tuple3f& step)
+{
+	quantized = true;
+	this->origin[0] = origin.x;
+	this->origin[1] = origin.y;
+	this->origin[2] = origin.z;
+	this->step[0] = step.x;
+	this->step[1] = step.y;
+	this->step[2] = step.z;
+}
+
+void TriangleSoA::dequantize()
+{
+	if (!quantized)
+	{
+		return;
+	}
+	for (int array = 0; array < 9; array++)
+	{
+		coordinates[array].resize(quantizedCoordinates[array].size());
+		for (size_t i = 0; i < count; i++)
+		{
+			coordinates[array][i] = coordinate(array, i);
+		}
+		std::fill(coordinates[array].begin() + count, coordinates[array].end(), 0.f);
+		quantizedCoordinates[array].clear();
+		quantizedCoordinates[array].shrink_to_fit();
+	}
+	quantized = false;
+}
+
+void TriangleSoA::dequantizeBlock(const int array, const size_t block, float* values) const
+{
+	const uint16_t* steps = quantizedCoordinates[array].data() + block;
+	const float low = origin[array % 3];
+	const float size = step[array % 3];
+	for (size_t lane = 0; lane < LANES; lane++)
+	{
+		values[lane] = low + steps[lane] * size;
+	}
+}
+
+void TriangleSoA::permute(const size_t first, const size_t last, const uint32_t* targets, const size_t copyFirst, const size_t copyCount, const size_t to)
+{
+	reserveGrowth(scratch, last - first);
+	scratch.resize(last - first);
+	for (auto& array : coordinates)
+	{
+		const float* values = array.data() + first;
+		for (size_t i = 0; i < last - first; i++)
+		{
+			scratch[targets[i]] = values[i];
+		}
+		std::copy(scratch.begin(), scratch.end(), array.begin() + first);
+		// the copy is taken from the scratch array, which is still in the cache
+		std::copy_n(scratch.begin() + copyFirst, copyCount, array.begin() + to);
+	}
+}
+
+void TriangleSoA::bounds(const size_t first, const size_t last, Tuple3f& min, Tuple3f& max) const
+{
+	float low[3];
+	float high[3];
+
+	if (quantized)
+	{
+		// the steps are bounded as integers, which the dequantization keeps in order
+		for (int axis = 0; axis < 3; axis++)
+		{
+			uint16_t lowStep = UINT16_MAX;
+			uint16_t highStep = 0;
+			for (int vertex = 0; vertex < 3; vertex++)
+			{
+				const uint16_t* steps = quantizedCoordinates[vertex * 3 + axis].data();
+				for (size_t i = first; i < last; i++)
+				{
+					lowStep = std::min(lowStep, steps[i]);
+					highStep = std::max(highStep, steps[i]);
+				}
+			}
+			low[axis] = origin[axis] + lowStep * step[axis];
+			high[axis] = origin[axis] + highStep * step[axis];
+		}
+		min = Tuple3f(low[0], low[1], low[2]);
+		max = Tuple3f(high[0], high[1], high[2]);
+		return;
+	}
+
+	// the whole blocks inside the range are reduced lane by lane, the partial blocks at its ends one triangle at a time
+	const size_t blockFirst = std::min(padded(first), last);
+	const size_t blockLast = std::max(last / LANES * LANES, blockFirst);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		low[axis] = high[axis] = coordinates[axis][first];
+		for (int vertex = 0; vertex < 3; vertex++)
+		{
+			const float* values = coordinates[vertex * 3 + axis].data();
+			for (size_t i = first; i < blockFirst; i++)
+			{
+				low[axis] = std::min(low[axis], values[i]);
+				high[axis] = std::max(high[axis], values[i]);
+			}
+			for (size_t i = blockLast; i < last; i++)
+			{
+				low[axis] = std::min(low[axis], values[i]);
+				high[axis] = std::max(high[axis], values[i]);
+			}
+		}
+		if (blockFirst == blockLast)
+		{
+			continue;
+		}
+
+		float lowLanes[LANES];
+		float highLanes[LANES];
+		for (size_t lane = 0; lane < LANES; lane++)
+		{
+			lowLanes[lane] = low[axis];
+			highLanes[lane] = high[axis];
+		}
+		for (int vertex = 0; vertex < 3; vertex++)
+		{
+			const float* values = coordinates[vertex * 3 + axis].data();
+			for (size_t block = blockFirst; block < blockLast; block += LANES)
+			{
+				for (size_t lane = 0; lane < LANES; lane++)
+				{
+					const float value = values[block + lane];
+					lowLanes[lane] = value < lowLanes[lane] ? value : lowLanes[lane];
+					highLanes[lane] = value > highLanes[lane] ? value : highLanes[lane];
+				}
+			}
+		}
+		for (size_t lane = 0; lane < LANES; lane++)
+		{
+			low[axis] = std::min(low[axis], lowLanes[lane]);
+			high[axis] = std::max(high[axis], highLanes[lane]);
+		}
+	}
+
+	min = Tuple3f(low[0], low[1], low[2]);
+	max = Tuple3f(high[0], high[1], high[2]);
+}
+
+void TriangleSoA::centroidBounds(const size_t first, const size_t last, Tuple3f& min, Tuple3f& max) const
+{
+	float low[3];
+	float high[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float* a = coordinates[axis].data();
+		const float* b = coordinates[3 + axis].data();
+		const float* c = coordinates[6 + axis].data();
+		low[axis] = high[axis] = (a[first] + b[first] + c[first]) / 3.f;
+		for (size_t i = first; i < last; i++)
+		{
+			const float centroid = (a[i] + b[i] + c[i]) / 3.f;
+			low[axis] = std::min(low[axis], centroid);
+			high[axis] = std::max(high[axis], centroid);
+		}
+	}
+
+	min = Tuple3f(low[0], low[1], low[2]);
+	max = Tuple3f(high[0], high[1], high[2]);
+}
+
+void TriangleSoA::bin(const size_t first, const size_t last, const int axis, const float origin, const float scale, const int binCount, TriangleBin* bins) const
+{
+	for (int i = 0; i < binCount; i++)
+	{
+		bins[i].count = 0;
+		std::fill(bins[i].min, bins[i].min + 3, INFINITY);
+		std::fill(bins[i].max, bins[i].max + 3, -INFINITY);
+	}
+
+	const float* a = coordinates[axis].data();
+	const float* b = coordinates[3 + axis].data();
+	const float* c = coordinates[6 + axis].data();
+	for (size_t i = first; i < last; i++)
+	{
+		const float centroid = (a[i] + b[i] + c[i]) / 3.f;
+		const int index = std::min(std::max(static_cast<int>((centroid - origin) * scale), 0), binCount - 1);
+		TriangleBin& bin = bins[index];
+		bin.count++;
+		for (int coordinate = 0; coordinate < 3; coordinate++)
+		{
+			const float va = coordinates[coordinate][i];
+			const float vb = coordinates[3 + coordinate][i];
+			const float vc = coordinates[6 + coordinate][i];
+			bin.min[coordinate] = std::min(bin.min[coordinate], std::min(va, std::min(vb, vc)));
+			bin.max[coordinate] = std::max(bin.max[coordinate], std::max(va, std::max(vb, vc)));
+		}
+	}
+}
+
+void TriangleSoA::classify(const size_t first, const size_t last, const int axis, const float position, uint8_t* sides) const
+{
+	const float* a = coordinates[axis].data();
+	const float* b = coordinates[3 + axis].data();
+	const float* c = coordinates[6 + axis].data();
+	for (size_t block = first / LANES * LANES; block < last; block += LANES)
+	{
+		// the whole block is classified, including the lanes outside the range, which are dropped below
+		uint8_t result[LANES];
+		for (size_t lane = 0; lane < LANES; lane++)
+		{
+			const float va = a[block + lane];
+			const float vb = b[block + lane];
+			const float vc = c[block + lane];
+			const int left = (va < position) | (vb < position) | (vc < position);
+			const int right = (va > position) | (vb > position) | (vc > position);
+			// 0 - left side, 1 - both sides, 2 - right side, 3 - neither side
+			result[lane] = static_cast<uint8_t>(left ? right : 3 - right);
+		}
+
+		const size_t begin = std::max(first, block);
+		const size_t end = std::min(last, block + LANES);
+		std::copy(result + (begin - block), result + (end - block), sides + (begin - first));
+	}
+}
+
+void TriangleSoA::classifyCentroids(const size_t first, const size_t last, const int axis, const float position, uint8_t* sides) const
+{
+	const float* a = coordinates[axis].data();
+	const float* b = coordinates[3 + axis].data();
+	const float* c = coordinates[6 + axis].data();
+	for (size_t block = first / LANES * LANES; block < last; block += LANES)
+	{
+		uint8_t result[LANES];
+		for (size_t lane = 0; lane < LANES; lane++)
+		{
+			const float centroid = (a[block + lane] + b[block + lane] + c[block + lane]) / 3.f;
+			result[lane] = static_cast<uint8_t>(centroid < position ? 0 : 2);
+		}
+
+		const size_t begin = std::max(first, block);
+		const size_t end = std::min(last, block + LANES);
+		std::copy(result + (begin - block), result + (end - block), sides + (begin - first));
+	}
+}
+
+void TriangleSoA::boxes(const size_t first, const size_t last, TriangleBox* boxes) const
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float* a = coordinates[axis].data();
+		const float* b = coordinates[3 + axis].data();
+		const float* c = coordinates[6 + axis].data();
+		for (size_t i = first; i < last; i++)
+		{
+			boxes[i - first].min[axis] = std::min(a[i], std::min(b[i], c[i]));
+			boxes[i - first].max[axis] = std::max(a[i], std::max(b[i], c[i]));
+		}
+	}
+}
+
+void TriangleSoA::split(const size_t i, const TriangleBox& box, const int axis, const float position, TriangleBox& left, TriangleBox& right) const
+{
+	float vertices[3][3];
+	for (int vertex = 0; vertex < 3; vertex++)
+	{
+		for (int coordinate = 0; coordinate < 3; coordinate++)
+		{
+			vertices[vertex][coordinate] = coordinates[vertex * 3 + coordinate][i];
+		}
+	}
+
+	for (int coordinate = 0; coordinate < 3; coordinate++)
+	{
+		left.min[coordinate] = right.min[coordinate] = INFINITY;
+		left.max[coordinate] = right.max[coordinate] = -INFINITY;
+	}
+	const auto grow = [](TriangleBox& part, const float* point)
+	{
+		for (int coordinate = 0; coordinate < 3; coordinate++)
+		{
+			part.min[coordinate] = std::min(part.min[coordinate], point[coordinate]);
+			part.max[coordinate] = std::max(part.max[coordinate], point[coordinate]);
+		}
+	};
+	for (int vertex = 0; vertex < 3; vertex++)
+	{
+		const float* a = vertices[vertex];
+		const float* b = vertices[(vertex + 1) % 3];
+		if (a[axis] <= position)
+		{
+			grow(left, a);
+		}
+		if (a[axis] >= position)
+		{
+			grow(right, a);
+		}
+		if ((a[axis] < position && b[axis] > position) || (a[axis] > position && b[axis] < position))
+		{
+			// the point where the edge crosses the plane belongs to both parts
+			const float t = (position - a[axis]) / (b[axis] - a[axis]);
+			float crossing[3];
+			for (int coordinate = 0; coordinate < 3; coordinate++)
+			{
+				crossing[coordinate] = a[coordinate] + (b[coordinate] - a[coordinate]) * t;
+			}
+			crossing[axis] = position;
+			grow(left, crossing);
+			grow(right, crossing);
+		}
+	}
+
+	// the earlier splits already cut the triangle to the box
+	for (int coordinate = 0; coordinate < 3; coordinate++)
+	{
+		left.min[coordinate] = std::max(left.min[coordinate], box.min[coordinate]);
+		left.max[coordinate] = std::min(left.max[coordinate], box.max[coordinate]);
+		right.min[coordinate] = std::max(right.min[coordinate], box.min[coordinate]);
+		right.max[coordinate] = std::min(right.max[coordinate], box.max[coordinate]);
+	}
+	left.max[axis] = std::min(left.max[axis], position);
+	right.min[axis] = std::max(right.min[axis], position);
+}
+
+void TriangleSoA::visible(const size_t first, const size_t last, const Tuple3f& cameraPosition, const Vector3f& cameraNormal, const float epsilon, uint8_t* visible) const
+{
+	const float tolerance = std::abs(cameraNormal.x) * errorBound.x + std::abs(cameraNormal.y) * errorBound.y + std::abs(cameraNormal.z) * errorBound.z;
+	const float limit = epsilon + tolerance;
+	for (size_t block = first / LANES * LANES; block < last; block += LANES)
+	{
+		// the whole block is tested, including the lanes outside the range, which are dropped below
+		uint8_t result[LANES] = {};
+		for (int vertex = 0; vertex < 3; vertex++)
+		{
+			// the quantized vertices are dequantized a block at a time, so the test below stays the same
+			float dequantized[3][LANES];
+			const float* x = dequantized[0];
+			const float* y = dequantized[1];
+			const float* z = dequantized[2];
+			if (quantized)
+			{
+				dequantizeBlock(vertex * 3, block, dequantized[0]);
+				dequantizeBlock(vertex * 3 + 1, block, dequantized[1]);
+				dequantizeBlock(vertex * 3 + 2, block, dequantized[2]);
+			}
+			else
+			{
+				x = coordinates[vertex * 3].data() + block;
+				y = coordinates[vertex * 3 + 1].data() + block;
+				z = coordinates[vertex * 3 + 2].data() + block;
+			}
+			for (size_t lane = 0; lane < LANES; lane++)
+			{
+				const float distance = cameraNormal.x * (cameraPosition.x - x[lane]) + cameraNormal.y * (cameraPosition.y - y[lane]) + cameraNormal.z * (cameraPosition.z - z[lane]);
+				result[lane] |= static_cast<uint8_t>(distance <= limit);
+			}
+		}
+
+		const size_t begin = std::max(first, block);
+		const size_t end = std::min(last, block + LANES);
+		std::copy(result + (begin - block), result + (end - block), visible + (begin - first));
+	}
+}
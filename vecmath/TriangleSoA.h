@@ -0,0 +1,262 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Tuple3f.h"
+#include "Vector3f.h"
+#include "../core/Core.h"
+#include "../core/MemoryArena.h"
+
+/** The triangles whose centroids fall into a bin along an axis (see TriangleSoA::bin()). */
+struct TriangleBin
+{
+	/** The number of triangles. */
+	uint32_t count;
+	/** The minimum point of the bounding box of the triangles. */
+	float min[3];
+	/** The maximum point of the bounding box of the triangles. */
+	float max[3];
+};
+
+/** The bounding box of the part of a triangle that lies in a node of a tree with spatial splits (see TriangleSoA::split()). */
+struct TriangleBox
+{
+	/** The minimum point. */
+	float min[3];
+	/** The maximum point. */
+	float max[3];
+};
+
+/**
+* The TriangleSoA stores triangles as a structure of arrays: each coordinate of each vertex (v1.x, v1.y, ..., v3.z) has its own array.
+* The arrays are padded to a multiple of LANES triangles and aligned to cache lines, so the kernels below process whole blocks of LANES
+* triangles with plain loops over aligned arrays, which the compiler turns into vector instructions (8 triangles per instruction with AVX2,
+* 16 with AVX-512). The stored vertices are copies, so the store can hold, e.g., the dequantized vertices of a QuantizedMesh.
+* The arrays may be taken from a MemoryArena, e.g., the arena of the tree owning the store.
+*
+* The store of a tree built from a QuantizedMesh may keep the coordinates as the 16-bit steps of its grid instead (see setQuantization()),
+* which halves the memory; the kernels of the queries, bounds() and visible(), dequantize the blocks on the fly.
+* The kernels of the construction (permute(), centroidBounds(), bin(), classify(), classifyCentroids(), boxes(), and split()) need the float coordinates.
+*/
+class TriangleSoA
+{
+
+public:
+
+	/** The number of triangles in a block; the arrays are padded to a multiple of it. */
+	static const size_t LANES = 16;
+
+private:
+
+	/** The alignment of the arrays in bytes (a cache line). */
+	static const size_t ALIGNMENT = 64;
+
+	/** The coordinate arrays; the array 3 * vertex + axis holds the given coordinate of the given vertex (0-2) of all triangles. */
+	ArenaVector<float, ALIGNMENT> coordinates[9];
+	/** The quantized coordinate arrays in the same layout; they are used instead of the float ones if quantized is true. */
+	ArenaVector<uint16_t, ALIGNMENT> quantizedCoordinates[9];
+	/** True if the coordinates are kept as the 16-bit steps of the grid given by origin and step. */
+	bool quantized = false;
+	/** The minimum corner of the grid in each axis. */
+	float origin[3] = {};
+	/** The size of a step of the grid in each axis. */
+	float step[3] = {};
+	/** The number of triangles. */
+	size_t count = 0;
+	/** The largest difference between the stored vertices and the original ones in each axis (zero for exact copies). */
+	Tuple3f errorBound;
+	/** The temporary copy of a single array used by permute(). */
+	ArenaVector<float> scratch;
+
+public:
+
+	/** Constructs an empty store taking its arrays from the given arena (from the heap if it is nullptr). */
+	TriangleSoA(MemoryArena* arena = nullptr);
+
+	/** Returns the number of triangles. */
+	size_t size() const
+	{
+		return count;
+	}
+
+	/** Changes the number of triangles; the stored triangles are kept and the added ones have to be set (or copied). */
+	void resize(size_t count);
+
+	/** Reserves the memory for the given number of triangles. */
+	void reserve(size_t count);
+
+	/** Removes all triangles and releases the memory; the store keeps floats again. */
+	void clear();
+
+	/** Sets the vertices of the i-th triangle. */
+	void set(size_t i, const Tuple3f& v1, const Tuple3f& v2, const Tuple3f& v3);
+
+	/** Returns the given coordinate (the array 3 * vertex + axis) of the i-th triangle. */
+	float coordinate(int array, size_t i) const
+	{
+		return quantized ? origin[array % 3] + quantizedCoordinates[array][i] * step[array % 3] : coordinates[array][i];
+	}
+
+	/** Returns the centroid of the i-th triangle. */
+	Tuple3f centroid(size_t i) const
+	{
+		return Tuple3f((coordinate(0, i) + coordinate(3, i) + coordinate(6, i)) / 3.f,
+			(coordinate(1, i) + coordinate(4, i) + coordinate(7, i)) / 3.f,
+			(coordinate(2, i) + coordinate(5, i) + coordinate(8, i)) / 3.f);
+	}
+
+	/**
+	* Makes the empty store keep its coordinates as the 16-bit steps of the given grid, e.g., that of a QuantizedMesh, instead of floats.
+	* The vertices set or copied into the store are rounded to the grid, so they should be the dequantized vertices of the same mesh.
+	*
+	* @param origin	The minimum corner of the grid.
+	* @param step	The size of a step of the grid in each axis.
+	*/
+	void setQuantization(const Tuple3f& origin, const Tuple3f& step);
+
+	/** Converts the quantized coordinates to floats, e.g., before vertices that are not on the grid are set; the store keeps floats from then on. */
+	void dequantize();
+
+	/** Returns true if the coordinates are kept as the 16-bit steps of a grid. */
+	bool isQuantized() const
+	{
+		return quantized;
+	}
+
+	/** Returns the minimum corner of the grid of the quantized coordinates. */
+	Tuple3f getOrigin() const
+	{
+		return Tuple3f(origin[0], origin[1], origin[2]);
+	}
+
+	/** Returns the size of a step of the grid of the quantized coordinates in each axis. */
+	Tuple3f getStep() const
+	{
+		return Tuple3f(step[0], step[1], step[2]);
+	}
+
+	/** Copies the given number of triangles of the source starting at the first one to the position to; the ranges must not overlap. Two quantized stores must share their grid. */
+	void copy(const TriangleSoA& source, size_t first, size_t count, size_t to);
+
+	/**
+	* Reorders the given range of triangles.
+	*
+	* @param first		The first triangle.
+	* @param last		The triangle after the last one.
+	* @param targets	The new position of each triangle of the range relative to the first one (a permutation of 0 to last - first - 1).
+	* @param copyFirst	The first reordered triangle (relative to the first one) to be also copied to the position to.
+	* @param copyCount	The number of the copied triangles (none by default).
+	* @param to		The position of the copy; it must not overlap the range.
+	*/
+	void permute(size_t first, size_t last, const uint32_t* targets, size_t copyFirst = 0, size_t copyCount = 0, size_t to = 0);
+
+	/** Sets the largest difference between the stored vertices and the original ones; the visibility test is widened by it. */
+	void setErrorBound(const Tuple3f& errorBound)
+	{
+		this->errorBound = errorBound;
+	}
+
+	/** Returns the largest difference between the stored vertices and the original ones. */
+	const Tuple3f& getErrorBound() const
+	{
+		return errorBound;
+	}
+
+	/** Returns the number of bytes occupied by the coordinate arrays. */
+	size_t memoryBytes() const
+	{
+		return coordinates[0].capacity() * sizeof(float) * 9 + quantizedCoordinates[0].capacity() * sizeof(uint16_t) * 9 + scratch.capacity() * sizeof(float);
+	}
+
+	/** Returns the number of bytes of the arrays that outgrew their arena and moved to the heap (see reserveGrowth()). */
+	size_t heapBytes() const
+	{
+		return heapCapacityBytes(coordinates[0]) * 9 + heapCapacityBytes(quantizedCoordinates[0]) * 9 + heapCapacityBytes(scratch);
+	}
+
+	/**
+	* Computes the bounding box of the vertices of the given range of triangles (which must not be empty).
+	*
+	* @param first		The first triangle.
+	* @param last		The triangle after the last one.
+	* @param min		Receives the minimum point.
+	* @param max		Receives the maximum point.
+	*/
+	void bounds(size_t first, size_t last, Tuple3f& min, Tuple3f& max) const;
+
+	/** Computes the bounding box of the centroids of the given range of triangles (which must not be empty). */
+	void centroidBounds(size_t first, size_t last, Tuple3f& min, Tuple3f& max) const;
+
+	/**
+	* Sorts the given range of triangles into equally wide bins along the axis by their centroids; each bin receives the number of its triangles
+	* and the bounding box of their vertices (an empty bin keeps an inverted box).
+	*
+	* @param first		The first triangle.
+	* @param last		The triangle after the last one.
+	* @param axis		The axis (0 - x, 1 - y, 2 - z).
+	* @param origin		The position on the axis where the first bin starts.
+	* @param scale		The number of bins per unit of length on the axis.
+	* @param binCount	The number of bins; the centroids outside the bins are put into the first or the last one.
+	* @param bins		Receives the bins.
+	*/
+	void bin(size_t first, size_t last, int axis, float origin, float scale, int binCount, TriangleBin* bins) const;
+
+	/**
+	* Classifies the given range of triangles by the plane perpendicular to the given axis.
+	* The side is 0 if the triangle lies only below the plane, 1 if it crosses it, 2 if it lies only above it, and 3 if it lies in the plane.
+	*
+	* @param first		The first triangle.
+	* @param last		The triangle after the last one.
+	* @param axis		The axis (0 - x, 1 - y, 2 - z).
+	* @param position	The position of the plane on the axis.
+	* @param sides		Receives the side of each triangle of the range (the side of the first triangle at index 0).
+	*/
+	void classify(size_t first, size_t last, int axis, float position, uint8_t* sides) const;
+
+	/**
+	* Classifies the given range of triangles by the side of the plane their centroids lie on, so no triangle is on both sides.
+	* The side is 0 if the centroid lies below the plane and 2 otherwise (see classify()).
+	*
+	* @param first		The first triangle.
+	* @param last		The triangle after the last one.
+	* @param axis		The axis (0 - x, 1 - y, 2 - z).
+	* @param position	The position of the plane on the axis.
+	* @param sides		Receives the side of each triangle of the range (the side of the first triangle at index 0).
+	*/
+	void classifyCentroids(size_t first, size_t last, int axis, float position, uint8_t* sides) const;
+
+	/** Computes the bounding boxes of the given range of triangles (the box of the first triangle at index 0). */
+	void boxes(size_t first, size_t last, TriangleBox* boxes) const;
+
+	/**
+	* Clips the part of the i-th triangle inside the given box by the plane perpendicular to the given axis: the vertices of the triangle on each side
+	* and the points where its edges cross the plane are bounded and the boxes are limited to the given box and the side of the plane.
+	* A side without any part of the triangle receives an inverted box (min above max on some axis).
+	*
+	* @param i			The triangle.
+	* @param box		The box of the part of the triangle being clipped.
+	* @param axis		The axis (0 - x, 1 - y, 2 - z).
+	* @param position	The position of the plane on the axis.
+	* @param left		Receives the box of the part below the plane.
+	* @param right		Receives the box of the part above the plane.
+	*/
+	void split(size_t i, const TriangleBox& box, int axis, float position, TriangleBox& left, TriangleBox& right) const;
+
+	/**
+	* Tests which triangles of the given range have at least one vertex on the side of the camera plane where the normal points to.
+	* The tolerance is widened by the error bound of the store, so a triangle visible in the original vertices is never reported as hidden.
+	*
+	* @param first			The first triangle.
+	* @param last			The triangle after the last one.
+	* @param cameraPosition	The position of the camera.
+	* @param cameraNormal	The normal of the camera plane.
+	* @param epsilon		The tolerance of the test.
+	* @param visible		Receives 1 for each visible triangle of the range and 0 for the others (the first triangle at index 0).
+	*/
+	void visible(size_t first, size_t last, const Tuple3f& cameraPosition, const Vector3f& cameraNormal, float epsilon, uint8_t* visible) const;
+
+private:
+
+	/** Dequantizes the LANES coordinates of the given array starting at the given triangle. */
+	void dequantizeBlock(int array, size_t block, float* values) const;
+};
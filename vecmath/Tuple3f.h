@@ -1,8 +1,12 @@
 #pragma once
+#include <cmath>
 #include <iostream>
+#include <type_traits>
 
 /** 
 * The simple class representing a 3D tuple. 
+* The class is trivially copyable and all its methods are defined here (most of them constexpr), so the compiler can inline
+* and vectorize the arithmetic instead of calling an out-of-line function for every operator.
 *
 * @author <a href="mailto:jan.byska@gmail.com">Jan Byka</a>
 */
@@ -19,7 +23,9 @@ public:
 
 public:
 	/** The default constructor that creates zero tuple (0,0,0). */
-	Tuple3f();
+	constexpr Tuple3f() : x(0), y(0), z(0)
+	{
+	}
 
 	/**
 	* The constructor allowing to set the actual x,y,z, coordinates.
@@ -28,45 +34,40 @@ public:
 	* @param y			The Y coordinate.
 	* @param z			The Z coordinate.
 	*/
-	Tuple3f(float x, float y, float z);
-
-	/**
-	* The copy constructor.
-	*
-	* @param other		The tuple its values will be copied into the new tuple.
-	*/
-	Tuple3f(const Tuple3f& other);
-
-	/** Destructor that releases the allocated memory if needed. */
-	~Tuple3f();
+	constexpr Tuple3f(float x, float y, float z) : x(x), y(y), z(z)
+	{
+	}
 
 	/**
 	* Returns the current X coordinate.
 	*
 	* @return the current X coordinate.
 	*/
-	inline float GetX() const { return this->x; };
+	constexpr float GetX() const { return this->x; };
 
 	/**
 	* Returns the current Y coordinate.
 	*
 	* @return the current Y coordinate.
 	*/
-	inline float GetY() const { return this->y; };
+	constexpr float GetY() const { return this->y; };
 
 	/**
 	* Returns the current Z coordinate
 	*
 	* @return the current Z coordinate.
 	*/
-	inline float GetZ() const { return this->z; };
+	constexpr float GetZ() const { return this->z; };
 
 	/** 
 	* Computes the distance between two tuples. 
 	* @param t1			The first tuple.
 	* @param t2			The second tuple.
 	*/
-	static float distance(const Tuple3f t1, const Tuple3f t2);
+	static float distance(const Tuple3f t1, const Tuple3f t2)
+	{
+		return std::sqrt(distanceSquared(t1, t2));
+	}
 
 	/**
 	* Computes the squared distance between two tuples. 
@@ -77,7 +78,11 @@ public:
 	* @param t1			The first tuple.
 	* @param t2			The second tuple.
 	*/
-	static float distanceSquared(const Tuple3f t1, const Tuple3f t2);
+	static constexpr float distanceSquared(const Tuple3f t1, const Tuple3f t2)
+	{
+		const Tuple3f vector = t1 - t2;
+		return vector.x * vector.x + vector.y * vector.y + vector.z * vector.z;
+	}
 
 	/**
 	* The new definition for the ostream '<<' operator allowing to print the tuple into a stream.
@@ -98,9 +103,18 @@ public:
 	* @param rhs		The reference to the tuple object on the right side of this operator. Note that the left side of this operator will be this object.
 	* @return			The new tuple that is a result of this operator.
 	*/
-	Tuple3f operator+ (const Tuple3f& rhs)  const;
+	constexpr Tuple3f operator+ (const Tuple3f& rhs) const
+	{
+		return Tuple3f(this->x + rhs.x, this->y + rhs.y, this->z + rhs.z);
+	}
 
-	Tuple3f& operator+= (const Tuple3f& rhs);
+	constexpr Tuple3f& operator+= (const Tuple3f& rhs)
+	{
+		this->x += rhs.x;
+		this->y += rhs.y;
+		this->z += rhs.z;
+		return *this;
+	}
 
 	/**
 	* The new definition for the '-' operator allowing to deduct two tuples coordinates-wise.
@@ -108,7 +122,10 @@ public:
 	* @param rhs		The reference to the number on the right side of this operator. Note that the left side of this operator will be this object.
 	* @return			The new tuple that is a result of this operator.
 	*/
-	Tuple3f operator- (const Tuple3f& rhs)  const;
+	constexpr Tuple3f operator- (const Tuple3f& rhs) const
+	{
+		return Tuple3f(this->x - rhs.x, this->y - rhs.y, this->z - rhs.z);
+	}
 
 	/**
 	* The new definition for the '*' operator allowing to multiply all coordinates by a number.
@@ -116,7 +133,10 @@ public:
 	* @param rhs		The reference to the number the right side of this operator. Note that the left side of this operator will be this object.
 	* @return			The new tuple that is a result of this operator.
 	*/
-	Tuple3f operator* (const float& rhs) const;
+	constexpr Tuple3f operator* (const float& rhs) const
+	{
+		return Tuple3f(this->x * rhs, this->y * rhs, this->z * rhs);
+	}
 
 	/**
 	* The new definition for the '/' operator allowing to divide all coordinates by a number.
@@ -124,7 +144,10 @@ public:
 	* @param rhs		The reference to the tuple object on the right side of this operator. Note that the left side of this operator will be this object.
 	* @return			The new tuple that is a result of this operator.
 	*/
-	Tuple3f operator/ (const float& rhs) const;
+	constexpr Tuple3f operator/ (const float& rhs) const
+	{
+		return Tuple3f(this->x / rhs, this->y / rhs, this->z / rhs);
+	}
 
 	/**
 	* The new definition for the '==' operator allowing to compare equality.
@@ -132,7 +155,10 @@ public:
 	* @param rhs		The reference to the tuple object on the right side of this operator. Note that the left side of this operator will be this object.
 	* @return			The {@p true} if this tuple is the same as the 'rhs' tuple; false otherwise.
 	*/
-	bool operator== (Tuple3f& rhs) const;
+	constexpr bool operator== (const Tuple3f& rhs) const
+	{
+		return this->x == rhs.x && this->y == rhs.y && this->z == rhs.z;
+	}
 
 	/**
 	* The new definition for the '!=' operator allowing to compare non-equality.
@@ -140,7 +166,10 @@ public:
 	* @param rhs		The reference to the tuple object on the right side of this operator. Note that the left side of this operator will be this object.
 	* @return			The {@p true} if this tuple not the same as the 'rhs' tuple; false otherwise.
 	*/
-	bool operator!= (Tuple3f& rhs) const;
+	constexpr bool operator!= (const Tuple3f& rhs) const
+	{
+		return !((*this) == rhs);
+	}
 
 	/**
 	* The new definition for the '<' operator allowing us to define order on tuples.
@@ -150,6 +179,11 @@ public:
 	* @param rhs		The reference to the tuple object on the right side of this operator. Note that the left side of this operator will be this object.
 	* @return			The {@p true} if this tuple is smaller then the 'rhs' tuple; false otherwise.
 	*/
-	bool operator< (const Tuple3f& rhs) const;
+	constexpr bool operator< (const Tuple3f& rhs) const
+	{
+		return this->x < rhs.x || (this->x == rhs.x && this->y < rhs.y) || (this->x == rhs.x && this->y == rhs.y && this->z < rhs.z);
+	}
 };
 
+static_assert(std::is_trivially_copyable<Tuple3f>::value, "the vertex arrays are hashed and copied as plain bytes");
+
@@ -0,0 +1,178 @@
+#pragma once
+#include <cmath>
+#include <type_traits>
+#include "Tuple3f.h"
+#include "Vector3f.h"
+
+// SSE2 is part of every x64 target; on 32-bit targets it depends on the /arch (-msse2) setting
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VECMATH_SSE 1
+#include <emmintrin.h>
+#endif
+
+/**
+* The four floats held in a single SSE register when SSE is available (see VECMATH_SSE) and in a plain array otherwise.
+* The operations are component-wise, so a single instruction processes all four components.
+*/
+class Vec4
+{
+
+private:
+
+#ifdef VECMATH_SSE
+	/** The components (x in the lowest lane). */
+	__m128 v;
+
+	Vec4(__m128 v) : v(v)
+	{
+	}
+#else
+	/** The components. */
+	float v[4];
+#endif
+
+public:
+
+	/** Creates the zero vector. */
+	Vec4() : Vec4(0, 0, 0, 0)
+	{
+	}
+
+	/** Creates the vector of the given components. */
+	Vec4(float x, float y, float z, float w)
+#ifdef VECMATH_SSE
+		: v(_mm_set_ps(w, z, y, x))
+#else
+		: v{ x, y, z, w }
+#endif
+	{
+	}
+
+	/** Creates the vector of the given tuple and the given fourth component. */
+	explicit Vec4(const Tuple3f& tuple, float w = 0) : Vec4(tuple.x, tuple.y, tuple.z, w)
+	{
+	}
+
+#ifdef VECMATH_SSE
+	float GetX() const { return _mm_cvtss_f32(v); }
+	float GetY() const { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))); }
+	float GetZ() const { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))); }
+	float GetW() const { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))); }
+
+	Vec4 operator+ (const Vec4& rhs) const { return _mm_add_ps(v, rhs.v); }
+	Vec4 operator- (const Vec4& rhs) const { return _mm_sub_ps(v, rhs.v); }
+	Vec4 operator* (const Vec4& rhs) const { return _mm_mul_ps(v, rhs.v); }
+	Vec4 operator* (float rhs) const { return _mm_mul_ps(v, _mm_set1_ps(rhs)); }
+	Vec4 operator/ (float rhs) const { return _mm_div_ps(v, _mm_set1_ps(rhs)); }
+
+	/** Returns the component-wise minimum. */
+	static Vec4 min(const Vec4& a, const Vec4& b) { return _mm_min_ps(a.v, b.v); }
+	/** Returns the component-wise maximum. */
+	static Vec4 max(const Vec4& a, const Vec4& b) { return _mm_max_ps(a.v, b.v); }
+	/** Returns the component-wise absolute value. */
+	static Vec4 abs(const Vec4& a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+#else
+	float GetX() const { return v[0]; }
+	float GetY() const { return v[1]; }
+	float GetZ() const { return v[2]; }
+	float GetW() const { return v[3]; }
+
+	Vec4 operator+ (const Vec4& rhs) const { return Vec4(v[0] + rhs.v[0], v[1] + rhs.v[1], v[2] + rhs.v[2], v[3] + rhs.v[3]); }
+	Vec4 operator- (const Vec4& rhs) const { return Vec4(v[0] - rhs.v[0], v[1] - rhs.v[1], v[2] - rhs.v[2], v[3] - rhs.v[3]); }
+	Vec4 operator* (const Vec4& rhs) const { return Vec4(v[0] * rhs.v[0], v[1] * rhs.v[1], v[2] * rhs.v[2], v[3] * rhs.v[3]); }
+	Vec4 operator* (float rhs) const { return Vec4(v[0] * rhs, v[1] * rhs, v[2] * rhs, v[3] * rhs); }
+	Vec4 operator/ (float rhs) const { return Vec4(v[0] / rhs, v[1] / rhs, v[2] / rhs, v[3] / rhs); }
+
+	/** Returns the component-wise minimum. */
+	static Vec4 min(const Vec4& a, const Vec4& b)
+	{
+		return Vec4(b.v[0] < a.v[0] ? b.v[0] : a.v[0], b.v[1] < a.v[1] ? b.v[1] : a.v[1], b.v[2] < a.v[2] ? b.v[2] : a.v[2], b.v[3] < a.v[3] ? b.v[3] : a.v[3]);
+	}
+	/** Returns the component-wise maximum. */
+	static Vec4 max(const Vec4& a, const Vec4& b)
+	{
+		return Vec4(b.v[0] > a.v[0] ? b.v[0] : a.v[0], b.v[1] > a.v[1] ? b.v[1] : a.v[1], b.v[2] > a.v[2] ? b.v[2] : a.v[2], b.v[3] > a.v[3] ? b.v[3] : a.v[3]);
+	}
+	/** Returns the component-wise absolute value. */
+	static Vec4 abs(const Vec4& a) { return Vec4(std::abs(a.v[0]), std::abs(a.v[1]), std::abs(a.v[2]), std::abs(a.v[3])); }
+#endif
+
+	Vec4& operator+= (const Vec4& rhs)
+	{
+		return *this = *this + rhs;
+	}
+
+	/** Returns the dot product of all four components. */
+	float Dot(const Vec4& other) const
+	{
+		const Vec4 product = *this * other;
+		return (product.GetX() + product.GetY()) + (product.GetZ() + product.GetW());
+	}
+
+	/** Returns the first three components as a tuple. */
+	Tuple3f toTuple3f() const
+	{
+		return Tuple3f(GetX(), GetY(), GetZ());
+	}
+};
+
+/**
+* The 3D vector held in a Vec4 with the fourth component zero, so the SSE instructions process it at once.
+* It provides the methods of Vector3f, so the code can switch between the two types.
+*/
+class Vec3 : public Vec4
+{
+
+public:
+
+	/** Creates the zero vector. */
+	Vec3() = default;
+
+	/** Creates the vector of the given coordinates. */
+	Vec3(float x, float y, float z) : Vec4(x, y, z, 0)
+	{
+	}
+
+	/** Creates the vector of the given tuple (or Vector3f). */
+	Vec3(const Tuple3f& tuple) : Vec4(tuple, 0)
+	{
+	}
+
+	/** Creates the vector of the first three components; the fourth component must be zero. */
+	Vec3(const Vec4& vector) : Vec4(vector)
+	{
+	}
+
+	/** Computes the dot product between this and some other vector. */
+	float Dot(const Vec3& other) const
+	{
+		const Vec4 product = *this * other;
+		return product.GetX() + product.GetY() + product.GetZ();
+	}
+
+	/** Computes the cross product between this and some other vector. */
+	Vec3 Cross(const Vec3& other) const
+	{
+		return Vector3f(toTuple3f()).Cross(Vector3f(other.toTuple3f()));
+	}
+
+	/** Returns the magnitude of this vector. */
+	float Magnitude() const
+	{
+		return std::sqrt(Dot(*this));
+	}
+
+	/** Normalizes this vector. */
+	void Normalize()
+	{
+		*this = *this / Magnitude();
+	}
+
+	/** Returns the vector as Vector3f. */
+	Vector3f toVector3f() const
+	{
+		return Vector3f(GetX(), GetY(), GetZ());
+	}
+};
+
+static_assert(std::is_trivially_copyable<Vec4>::value && std::is_trivially_copyable<Vec3>::value, "the vectors live in registers");
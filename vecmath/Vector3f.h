@@ -1,8 +1,10 @@
 #pragma once
 #include "Tuple3f.h"
+#include <cmath>
 
 /**
 * The extension of the Tuple3f class adding some methods specific for vectors. 
+* Like Tuple3f, the class is trivially copyable and defined only in this header.
 *
 * @author <a href="mailto:jan.byska@gmail.com">Jan Byka</a>
 */
@@ -11,7 +13,9 @@ class Vector3f : public Tuple3f
 public:
 
 	/** The default constructor that creates zero vector (0,0,0). */
-	Vector3f();
+	constexpr Vector3f() : Tuple3f(0, 0, 0)
+	{
+	}
 
 	/**
 	* The constructor allowing to set the actual x,y,z, coordinates.
@@ -20,27 +24,37 @@ public:
 	* @param y			The Y coordinate.
 	* @param z			The Z coordinate.
 	*/
-	Vector3f(const float x, const float y, const float z);
+	constexpr Vector3f(const float x, const float y, const float z) : Tuple3f(x, y, z)
+	{
+	}
 
 	/**
 	* The copy constructor allowing us to create vector from any Tuple3f.
 	*
 	* @param other		The tuple its values will be copied into the new vector.
 	*/
-	Vector3f(const Tuple3f& other);
-
-	/** Destructor that releases the allocated memory if needed. */
-	~Vector3f();
+	constexpr Vector3f(const Tuple3f& other) : Tuple3f(other)
+	{
+	}
 
 	/** Normalizes this vector. */
-	void Normalize();
+	void Normalize()
+	{
+		const float magnitude = this->Magnitude();
+		this->x = this->x / magnitude;
+		this->y = this->y / magnitude;
+		this->z = this->z / magnitude;
+	}
 	
 	/** 
 	* Returns the magnitude of this vector. 
 	* 
 	* @return			The magnitude of this vector.
 	*/
-	float Magnitude() const;
+	float Magnitude() const
+	{
+		return std::sqrt(this->x * this->x + this->y * this->y + this->z * this->z);
+	}
 
 	/**
 	* Computes the dot product between this and some other vector.
@@ -48,7 +62,10 @@ public:
 	* @param other		The other vector.
 	* @return			The dot product between this and the given vector.
 	*/
-	float Dot(const Vector3f& other) const;
+	constexpr float Dot(const Vector3f& other) const
+	{
+		return this->x * other.x + this->y * other.y + this->z * other.z;
+	}
 
 	/**
 	* Computes the cross product between this and some other vector.
@@ -56,12 +73,32 @@ public:
 	* @param other		The other vector.
 	* @return			The cross product between this and the given vector.
 	*/
-	Vector3f Cross(const Vector3f& other) const;
+	constexpr Vector3f Cross(const Vector3f& other) const
+	{
+		return Vector3f(this->y * other.z - this->z * other.y, this->z * other.x - this->x * other.z, this->x * other.y - this->y * other.x);
+	}
 
 	/**
 	 * Rotates vector along given axis by the given angle.
 	 */
-	Vector3f Rotate(float angle, Vector3f axis) const;
+	Vector3f Rotate(const float theta, Vector3f axis) const
+	{
+		axis.Normalize();
+
+		const float xPrime = axis.x * (axis.x * x + axis.y * y + axis.z * z) * (1 - cos(theta))
+			+ x * cos(theta)
+			+ (-axis.z * y + axis.y * z) * sin(theta);
+		const float yPrime = axis.y * (axis.x * x + axis.y * y + axis.z * z) * (1 - cos(theta))
+			+ y * cos(theta)
+			+ (axis.z * x - axis.x * z) * sin(theta);
+		const float zPrime = axis.z * (axis.x * x + axis.y * y + axis.z * z) * (1 - cos(theta))
+			+ z * cos(theta)
+			+ (-axis.y * x + axis.x * y) * sin(theta);
+
+		return Vector3f(xPrime, yPrime, zPrime);
+	}
 	
 };
 
+static_assert(std::is_trivially_copyable<Vector3f>::value, "vectors are passed by value, which must stay a plain copy");
+